@@ -0,0 +1,455 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Benchmark runner: generates each synthetic scene kind at each size, and
+    times load, plane setup, tree build and every query type. Results are
+    written as JSON for tracking between releases.
+*******************************************************************************/
+
+#include "gen.h"
+#include "../src/bsp.h"
+#include "../src/camera.h"
+#include "../src/data.h"
+#include "../src/draw.h"
+#include "../src/mem.h"
+#include "../src/quality.h"
+#include "../src/query.h"
+#include "../src/select.h"
+#include "../src/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_QUERIES 10000U
+#define BENCH_VIEWS   64U
+#define BENCH_BUDGET  60.0          /* Build seconds past which a kind stops */
+#define BENCH_SCENE   "bench_scene" /* Scratch VTX / IDX pair */
+#define BENCH_FULL    0xFFF0U       /* Pools this close to 16 bits overflowed */
+#define BENCH_TREE    "tree.txt"    /* Dump every build leaves behind */
+#define BENCH_MEM     1024U         /* Room for one mem_json object */
+
+
+
+/* What the core modules expect from the viewer, without a window */
+pools g_pool;
+bsp   g_bsp;
+
+unsigned short
+    g_bsp_l = 0, g_bsp_r = -1, g_pivot_l = 0, g_pivot_r = 0, g_pivot = -1,
+    g_poly_clip = 0, g_poly_inter = 0, g_vert_012[3] = {0};
+DRAW_MODE g_draw_mode = DRAW_MODE_UNSPECIFIED;
+
+float window_get_aspect_ratio(void) { return 16.0f / 9.0f; }
+
+
+
+static size_t const bench_sizes[] = { 1024U, 4096U, 16384U, 65535U };
+
+typedef struct {
+    char const *name;
+    size_t      n;     /* Queries run */
+    double      sec;
+} bench_query;
+
+typedef struct {
+    GEN_KIND    kind;
+    size_t      size, verts, faces, built, nodes;
+    size_t      splits;
+    unsigned    depth;
+    size_t      mem_peak;  /* Bytes, during the build */
+    char        mem[BENCH_MEM]; /* mem_json just after the build, or "" */
+    double      load, planes, build;
+    char const *status; /* "ok", "skipped", "overflow" or "failed" */
+    char const *reason; /* Skipped: "budget", or what the smaller size was */
+    bool        ok;
+    bench_query q[6];
+    unsigned    n_q;
+    quality     qual;
+    bool        measured;
+} bench_result;
+
+static select_stats bench_builds[GEN_COUNT]; /* Each kind's builds, merged */
+
+
+
+/* A point in the scene bounds grown by a tenth each way */
+static void
+bench_point(float *out, float const *lo, float const *hi, unsigned *s)
+{
+    unsigned k;
+
+    for (k = 0; k < 3; ++k)
+    {
+        float const pad = (hi[k] - lo[k]) * 0.1f;
+        out[k] = lo[k] - pad + math_rand(s) * (hi[k] - lo[k] + 2.0f*pad);
+    }
+}
+
+static bool
+bench_write(pools const *p, char const *name)
+{
+    char path[256];
+    FILE *f;
+    bool ok;
+
+    snprintf(path, sizeof(path), "%s.VTX", name);
+    if (!(f = fopen(path, "wb"))) return false;
+    ok = fwrite(p->verts, sizeof(vert), p->n_verts, f) == p->n_verts;
+    if (fclose(f) || !ok) return false;
+
+    snprintf(path, sizeof(path), "%s.IDX", name);
+    if (!(f = fopen(path, "wb"))) return false;
+    ok = fwrite(p->faces, sizeof(face), p->n_faces, f) == p->n_faces;
+    return !fclose(f) && ok;
+}
+
+static void
+bench_remove(char const *name)
+{
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s.VTX", name);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.IDX", name);
+    remove(path);
+}
+
+
+
+static void
+bench_queries(bench_result *r, size_t n_queries)
+{
+    query_segment *segs = malloc(n_queries * sizeof(*segs));
+    bool *blocked = malloc(n_queries * sizeof(*blocked));
+    unsigned short *order = malloc(g_pool.n_faces * sizeof(*order));
+    bsp_visit *stack = malloc(g_bsp.occ * sizeof(*stack));
+    float lo[3], hi[3], ext[3], rad;
+    plane frustum[6];
+    query_hit hit;
+    unsigned seed = 99U, k;
+    size_t i, sink = 0U;
+    double t0;
+
+    if (!segs || !blocked || !order || !stack)
+    {
+        fprintf(stderr, "Out of memory for queries.\n");
+        free(segs);
+        free(blocked);
+        free(order);
+        free(stack);
+        return;
+    }
+
+    memcpy(lo, g_pool.verts[0].m, sizeof(lo));
+    memcpy(hi, g_pool.verts[0].m, sizeof(hi));
+    for (i = 1; i < g_pool.n_verts; ++i)
+    {
+        for (k = 0; k < 3; ++k)
+        {
+            if (g_pool.verts[i].m[k] < lo[k]) lo[k] = g_pool.verts[i].m[k];
+            if (g_pool.verts[i].m[k] > hi[k]) hi[k] = g_pool.verts[i].m[k];
+        }
+    }
+    rad = 0.0f;
+    for (k = 0; k < 3; ++k) rad += hi[k] - lo[k];
+    rad *= 0.003f;
+    ext[0] = ext[1] = ext[2] = rad;
+
+    for (i = 0; i < n_queries; ++i)
+    {
+        bench_point(segs[i].a, lo, hi, &seed);
+        bench_point(segs[i].b, lo, hi, &seed);
+    }
+
+    r->q[0].name = "segment";
+    t0 = timer_now();
+    for (i = 0; i < n_queries; ++i)
+        sink += query_segment_blocked(&g_bsp, &g_pool, segs[i].a, segs[i].b);
+    r->q[0].sec = timer_now() - t0;
+    r->q[0].n   = n_queries;
+
+    r->q[1].name = "segments_threaded";
+    t0 = timer_now();
+    sink += query_segments_blocked(&g_bsp, &g_pool, segs, blocked, n_queries, 0U);
+    r->q[1].sec = timer_now() - t0;
+    r->q[1].n   = n_queries;
+
+    r->q[2].name = "sweep_sphere";
+    t0 = timer_now();
+    for (i = 0; i < n_queries; ++i)
+        sink += query_sweep_sphere(&g_bsp, &g_pool, segs[i].a, segs[i].b,
+                                   rad, &hit);
+    r->q[2].sec = timer_now() - t0;
+    r->q[2].n   = n_queries;
+
+    r->q[3].name = "sweep_box";
+    t0 = timer_now();
+    for (i = 0; i < n_queries; ++i)
+        sink += query_sweep_box(&g_bsp, &g_pool, segs[i].a, segs[i].b,
+                                ext, &hit);
+    r->q[3].sec = timer_now() - t0;
+    r->q[3].n   = n_queries;
+
+    r->q[4].name = "order";
+    t0 = timer_now();
+    for (i = 0; i < BENCH_VIEWS; ++i)
+        sink += bsp_order(&g_bsp, &g_pool, segs[i % n_queries].a,
+                          BSP_ORDER_BACK_TO_FRONT, stack, g_bsp.occ,
+                          order, g_pool.n_faces);
+    r->q[4].sec = timer_now() - t0;
+    r->q[4].n   = BENCH_VIEWS;
+
+    /* Views from each segment start towards its end */
+    r->q[5].name = "order_clipped";
+    camera_reset();
+    t0 = timer_now();
+    for (i = 0; i < BENCH_VIEWS; ++i)
+    {
+        query_segment const *s = segs + i % n_queries;
+        float ori[3] = {0.0f, 0.0f, 0.0f};
+
+        ori[CAM_ORI_YAW] = (float)i * 0.7f;
+        camera_snap(s->a);
+        camera_turn(ori);
+        camera_get_frustum(frustum);
+        sink += bsp_order_clipped(&g_bsp, &g_pool, s->a, frustum, 6U,
+                                  BSP_ORDER_FRONT_TO_BACK, stack, g_bsp.occ,
+                                  order, g_pool.n_faces);
+    }
+    r->q[5].sec = timer_now() - t0;
+    r->q[5].n   = BENCH_VIEWS;
+
+    r->n_q = 6U;
+    if (sink == (size_t)-1) fprintf(stderr, "\n"); /* Keep the work */
+
+    free(segs);
+    free(blocked);
+    free(order);
+    free(stack);
+}
+
+/* Keeps the memory held once built: the pools are gone by the time the
+ * results are written */
+static void
+bench_mem(bench_result *r)
+{
+    FILE *t = tmpfile();
+    size_t n = 0U;
+
+    if (t && mem_json(t, &g_pool, &g_bsp) && !fseek(t, 0, SEEK_SET))
+        n = fread(r->mem, 1, sizeof(r->mem) - 1U, t);
+    r->mem[n] = '\0';
+    if (t) fclose(t);
+}
+
+static bench_result
+bench_scene(GEN_KIND kind, size_t size, size_t n_queries)
+{
+    bench_result r;
+    select_stats st;
+    select_level tot;
+    double t0;
+    bool built;
+
+    memset(&r, 0, sizeof(r));
+    r.kind   = kind;
+    r.size   = size;
+    r.status = "failed";
+
+    pools_free(&g_pool);
+    bsp_free(&g_bsp);
+    if (!gen_scene(&g_pool, kind, size, 1U) ||
+        !bench_write(&g_pool, BENCH_SCENE))
+    {
+        fprintf(stderr, "Failed to generate %s/%zu.\n", gen_name(kind), size);
+        return r;
+    }
+    pools_free(&g_pool);
+
+    t0 = timer_now();
+    if (!read_data(&g_pool, BENCH_SCENE, NULL)) return r;
+    r.load = timer_now() - t0;
+    r.verts = g_pool.n_verts;
+
+    t0 = timer_now();
+    if (!pools_check(&g_pool, NULL) || !pools_make_planes(&g_pool, NULL))
+        return r;
+    r.planes = timer_now() - t0;
+    r.faces  = g_pool.n_faces;
+
+    st.perf = NULL;
+    st.log  = NULL;
+    /* The builder's own clock leaves out its report and tree dump */
+    built = select_begin(&g_pool, &st);
+    r.build = st.t_total;
+    remove(BENCH_TREE);
+    select_stats_merge(bench_builds + kind, &st);
+    if ((!built && !st.full) || !g_bsp.occ) return r;
+    r.built = g_pool.n_faces;
+    r.nodes = g_bsp.occ;
+    select_stats_total(&st, &tot);
+    r.splits   = tot.splits;
+    r.depth    = st.depth;
+    r.mem_peak = st.mem_peak;
+    bench_mem(&r);
+
+    /* Splits ran out of indices: the tree is incomplete */
+    if (st.full || g_pool.n_verts >= BENCH_FULL ||
+        g_pool.n_faces >= BENCH_FULL)
+    {
+        r.status = "overflow";
+        return r;
+    }
+    r.status   = "ok";
+    r.ok       = true;
+    r.measured = quality_measure(&g_bsp, &g_pool, r.faces, 0U, &r.qual);
+
+    bench_queries(&r, n_queries);
+    return r;
+}
+
+
+
+static void
+bench_json(FILE *f, bench_result const *r, size_t n, size_t n_queries,
+           size_t max, double budget, select_stats const *builds)
+{
+    size_t i;
+    unsigned k;
+    bool first = true;
+
+    fprintf(f, "{\n  \"version\": 1,\n  \"queries\": %zu,\n"
+               "  \"max_faces\": %zu,\n  \"budget_s\": %.1f,\n"
+               "  \"scenes\": [", n_queries, max, budget);
+    for (i = 0; i < n; ++i, ++r)
+    {
+        fprintf(f, "%s\n    {\"scene\": \"%s\", \"size\": %zu, \"status\": \"%s\", "
+                   "\"verts\": %zu, \"faces\": %zu, \"faces_built\": %zu, "
+                   "\"nodes\": %zu, \"splits\": %zu, \"depth\": %u, "
+                   "\"mem_peak_kib\": %zu,\n     \"load_ms\": %.3f, "
+                   "\"planes_ms\": %.3f, \"build_ms\": %.3f,\n"
+                   "     \"queries\": {",
+                i ? "," : "", gen_name(r->kind), r->size,
+                r->status, r->verts, r->faces, r->built,
+                r->nodes, r->splits, r->depth, r->mem_peak >> 10,
+                r->load*1e3, r->planes*1e3, r->build*1e3);
+        for (k = 0; k < r->n_q; ++k)
+        {
+            fprintf(f, "%s\"%s_ns\": %.1f", k ? ", " : "", r->q[k].name,
+                    r->q[k].sec * 1e9 / (double)r->q[k].n);
+        }
+        fputc('}', f);
+        if (r->reason) fprintf(f, ", \"reason\": \"%s\"", r->reason);
+        if (r->mem[0]) fprintf(f, ",\n     \"memory\": %s", r->mem);
+        if (r->measured)
+        {
+            fprintf(f, ",\n     \"quality\": ");
+            quality_json(&r->qual, f);
+        }
+        fputc('}', f);
+    }
+
+    /* Per depth counts of every build of a kind, whatever its status */
+    fprintf(f, "\n  ],\n  \"builds\": {");
+    for (k = 0; k < GEN_COUNT; ++k)
+    {
+        if (!builds[k].t_total) continue;
+        fprintf(f, "%s\n  \"%s\": ", first ? "" : ",", gen_name((GEN_KIND)k));
+        select_stats_json(builds + k, f);
+        first = false;
+    }
+    fprintf(f, "}\n}\n");
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage:\n  bsp_bench [-n max_faces] [-q queries] "
+                    "[-t seconds] [-o out.json]\n"
+                    "    -n  largest scene size run (default: index limit)\n"
+                    "    -q  queries per type (default %u)\n"
+                    "    -t  build time after which a scene kind stops "
+                    "growing (default %.0f)\n"
+                    "    -o  results file (default bench.json)\n",
+                    BENCH_QUERIES, BENCH_BUDGET);
+}
+
+int main(int argc, char **argv)
+{
+    bench_result r[GEN_COUNT * sizeof(bench_sizes)/sizeof(*bench_sizes)];
+    char const *out = "bench.json";
+    char const *stop[GEN_COUNT] = {NULL}; /* Why a kind stopped growing */
+    size_t max = 0xFFFFU, n_queries = BENCH_QUERIES, n = 0U, s;
+    double budget = BENCH_BUDGET;
+    unsigned kind, k;
+    FILE *f;
+
+    for (; argc > 2 && argv[1][0] == '-'; argv += 2, argc -= 2)
+    {
+        if      (!strcmp(argv[1], "-n")) max = strtoul(argv[2], NULL, 10);
+        else if (!strcmp(argv[1], "-q")) n_queries = strtoul(argv[2], NULL, 10);
+        else if (!strcmp(argv[1], "-t")) budget = strtod(argv[2], NULL);
+        else if (!strcmp(argv[1], "-o")) out = argv[2];
+        else break;
+    }
+    if (argc != 1 || !n_queries)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    pools_init(&g_pool);
+    bsp_init(&g_bsp);
+
+    for (s = 0; s < sizeof(bench_sizes)/sizeof(*bench_sizes); ++s)
+    {
+        if (bench_sizes[s] > max) break;
+        for (kind = 0; kind < GEN_COUNT; ++kind, ++n)
+        {
+            /* Builds grow faster than linearly: once one size of a kind
+             * blows the budget, the larger ones are only recorded, with
+             * why they were not run */
+            if (stop[kind])
+            {
+                memset(r + n, 0, sizeof(*r));
+                r[n].kind   = (GEN_KIND)kind;
+                r[n].size   = bench_sizes[s];
+                r[n].status = "skipped";
+                r[n].reason = stop[kind];
+                printf("%-8s %6zu: skipped (%s)\n", gen_name(r[n].kind),
+                       r[n].size, r[n].reason);
+                continue;
+            }
+            r[n] = bench_scene((GEN_KIND)kind, bench_sizes[s], n_queries);
+            if (!r[n].ok) stop[kind] = r[n].status;
+            else if (r[n].build > budget) stop[kind] = "budget";
+            printf("%-8s %6zu: %6zu faces -> %6zu, load %8.3f ms, planes "
+                   "%8.3f ms, build %10.3f ms (%s)\n",
+                   gen_name(r[n].kind), r[n].size, r[n].faces, r[n].built,
+                   r[n].load*1e3, r[n].planes*1e3, r[n].build*1e3,
+                   r[n].status);
+            for (k = 0; k < r[n].n_q; ++k)
+            {
+                printf("    %-18s %12.1f ns\n", r[n].q[k].name,
+                       r[n].q[k].sec * 1e9 / (double)r[n].q[k].n);
+            }
+            fflush(stdout);
+        }
+    }
+    bench_remove(BENCH_SCENE);
+    bsp_free(&g_bsp);
+    pools_free(&g_pool);
+
+    if (!(f = fopen(out, "w")))
+    {
+        fprintf(stderr, "Failed to open \"%s\" for writing.\n", out);
+        return EXIT_FAILURE;
+    }
+    bench_json(f, r, n, n_queries, max, budget, bench_builds);
+    fclose(f);
+    printf("Results written to \"%s\".\n", out);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Deterministic synthetic scenes for benchmarking: the same kind, size and
+    seed always give the same pools.
+*******************************************************************************/
+
+#include "gen.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define GEN_INDEX_MAX 0xFFFFU /* Verts and faces are addressed in 16 bits */
+#define GEN_PI        3.14159265f
+#define GEN_EXTENT    1.0f    /* Scenes are scaled to fit a cube this wide */
+
+
+
+static char const *const gen_names[GEN_COUNT] = {
+    "soup", "rooms", "sphere", "terrain", "clutter"
+};
+
+char const *
+gen_name(GEN_KIND kind)
+{
+    return kind < GEN_COUNT ? gen_names[kind] : "unknown";
+}
+
+
+
+static void
+gen_vert(pools *p, size_t i, float x, float y, float z)
+{
+    p->verts[i].m[0] = x;
+    p->verts[i].m[1] = y;
+    p->verts[i].m[2] = z;
+}
+
+static void
+gen_face(pools *p, size_t i, size_t a, size_t b, size_t c)
+{
+    p->faces[i].i[0] = (unsigned short)a;
+    p->faces[i].i[1] = (unsigned short)b;
+    p->faces[i].i[2] = (unsigned short)c;
+}
+
+static size_t
+gen_min(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+
+
+/* Free standing triangles of edge about `size` around centres in a cube
+ * of side `span` */
+static bool
+gen_triangles(pools *out, size_t n, float span, float size, unsigned seed)
+{
+    size_t i, k;
+
+    n = gen_min(n, GEN_INDEX_MAX / 3U);
+    if (!pools_alloc(out, n*3U, n)) return false;
+
+    for (i = 0; i < n; ++i)
+    {
+        float c[3];
+
+        c[0] = math_rand(&seed) * span;
+        c[1] = math_rand(&seed) * span;
+        c[2] = math_rand(&seed) * span;
+        for (k = 0; k < 3; ++k)
+        {
+            gen_vert(out, i*3U + k,
+                     c[0] + (math_rand(&seed) - 0.5f) * size,
+                     c[1] + (math_rand(&seed) - 0.5f) * size,
+                     c[2] + (math_rand(&seed) - 0.5f) * size);
+        }
+        gen_face(out, i, i*3U, i*3U + 1U, i*3U + 2U);
+    }
+    return true;
+}
+
+/* Boxes of 8 corners and 12 inward facing triangles, on a square plan
+ * with randomised room sizes */
+static bool
+gen_rooms(pools *out, size_t n, unsigned seed)
+{
+    /* Corner order: bit 0 = x, bit 1 = y, bit 2 = z */
+    static unsigned char const quads[6][4] = {
+        {0, 2, 6, 4}, {1, 5, 7, 3}, /* -x, +x */
+        {0, 4, 5, 1}, {2, 3, 7, 6}, /* -y, +y */
+        {0, 1, 3, 2}, {4, 6, 7, 5}, /* -z, +z */
+    };
+    size_t boxes, side, b, q;
+
+    boxes = gen_min(n / 12U, GEN_INDEX_MAX / 12U);
+    if (!boxes) boxes = 1U;
+    for (side = 1U; side*side < boxes; ++side);
+    if (!pools_alloc(out, boxes*8U, boxes*12U)) return false;
+
+    for (b = 0; b < boxes; ++b)
+    {
+        float const x0 = (float)(b % side) * 12.0f;
+        float const z0 = (float)(b / side) * 12.0f;
+        float const w  = 6.0f + math_rand(&seed) * 5.0f;
+        float const h  = 3.0f + math_rand(&seed) * 3.0f;
+        float const d  = 6.0f + math_rand(&seed) * 5.0f;
+        size_t const v = b*8U, f = b*12U;
+        unsigned k;
+
+        for (k = 0; k < 8; ++k)
+        {
+            gen_vert(out, v + k, x0 + (k & 1U ? w : 0.0f),
+                                      (k & 2U ? h : 0.0f),
+                                 z0 + (k & 4U ? d : 0.0f));
+        }
+        for (q = 0; q < 6; ++q)
+        {
+            gen_face(out, f + q*2U,
+                     v + quads[q][0], v + quads[q][1], v + quads[q][2]);
+            gen_face(out, f + q*2U + 1U,
+                     v + quads[q][0], v + quads[q][2], v + quads[q][3]);
+        }
+    }
+    return true;
+}
+
+/* Latitude / longitude sphere with twice as many slices as stacks */
+static bool
+gen_sphere(pools *out, size_t n)
+{
+    size_t st, sl, s, t, nv, nf, f = 0U;
+    float const r = 50.0f;
+
+    /* Faces = 2*sl*(st-1) = 4*st*(st-1) */
+    for (st = 2U; 4U*(st+1U)*st <= n && 2U*(st+1U)*st + 2U <= GEN_INDEX_MAX;
+         ++st);
+    sl = st*2U;
+    nv = (st-1U)*sl + 2U;
+    nf = 2U*sl*(st-1U);
+    if (!pools_alloc(out, nv, nf)) return false;
+
+    gen_vert(out, 0U,      0.0f,  r, 0.0f);
+    gen_vert(out, nv - 1U, 0.0f, -r, 0.0f);
+    for (t = 1; t < st; ++t)
+    {
+        float const phi = GEN_PI * (float)t / (float)st;
+
+        for (s = 0; s < sl; ++s)
+        {
+            float const th = 2.0f*GEN_PI * (float)s / (float)sl;
+
+            gen_vert(out, 1U + (t-1U)*sl + s, r * sinf(phi) * cosf(th),
+                                              r * cosf(phi),
+                                              r * sinf(phi) * sinf(th));
+        }
+    }
+
+    for (s = 0; s < sl; ++s)
+    {
+        size_t const s1 = (s + 1U) % sl;
+
+        gen_face(out, f++, 0U, 1U + s1, 1U + s);
+        for (t = 1; t + 1U < st; ++t)
+        {
+            size_t const a = 1U + (t-1U)*sl, b = a + sl;
+
+            gen_face(out, f++, a + s, a + s1, b + s1);
+            gen_face(out, f++, a + s, b + s1, b + s);
+        }
+        gen_face(out, f++, nv - 1U, 1U + (st-2U)*sl + s,
+                                    1U + (st-2U)*sl + s1);
+    }
+    return true;
+}
+
+/* w by w quads of two triangles over rolling hills with some noise */
+static bool
+gen_terrain(pools *out, size_t n, unsigned seed)
+{
+    size_t w, x, z, f = 0U;
+
+    for (w = 1U; 2U*(w+1U)*(w+1U) <= n &&
+                 (w+2U)*(w+2U) <= GEN_INDEX_MAX; ++w);
+    if (!pools_alloc(out, (w+1U)*(w+1U), 2U*w*w)) return false;
+
+    for (z = 0; z <= w; ++z)
+    {
+        for (x = 0; x <= w; ++x)
+        {
+            float const fx = (float)x, fz = (float)z;
+
+            gen_vert(out, z*(w+1U) + x, fx,
+                     4.0f * sinf(fx * 0.11f) * cosf(fz * 0.07f) +
+                     1.5f * sinf((fx + fz) * 0.31f) +
+                     0.5f * math_rand(&seed), fz);
+        }
+    }
+
+    for (z = 0; z < w; ++z)
+    {
+        for (x = 0; x < w; ++x)
+        {
+            size_t const a = z*(w+1U) + x, b = a + w + 1U;
+
+            gen_face(out, f++, a, b, a + 1U);
+            gen_face(out, f++, a + 1U, b, b + 1U);
+        }
+    }
+    return true;
+}
+
+
+
+/* The builder classifies against FLT_EPSILON in absolute terms: at unit
+ * scale the points it cuts at stay on their plane, and splits do not
+ * cascade */
+static void
+gen_fit(pools *p)
+{
+    float lo = p->verts[0].m[0], hi = lo, s;
+    size_t i;
+    unsigned k;
+
+    for (i = 0; i < p->n_verts; ++i)
+    {
+        for (k = 0; k < 3; ++k)
+        {
+            if (p->verts[i].m[k] < lo) lo = p->verts[i].m[k];
+            if (p->verts[i].m[k] > hi) hi = p->verts[i].m[k];
+        }
+    }
+    s = hi > lo ? GEN_EXTENT / (hi - lo) : 1.0f;
+    for (i = 0; i < p->n_verts; ++i)
+    {
+        for (k = 0; k < 3; ++k) p->verts[i].m[k] *= s;
+    }
+}
+
+bool
+gen_scene(pools *out, GEN_KIND kind, size_t faces, unsigned seed)
+{
+    bool ok;
+
+    if (!out) return false;
+
+    switch (kind)
+    {
+    case GEN_SOUP:    ok = gen_triangles(out, faces, 100.0f, 2.0f, seed); break;
+    case GEN_ROOMS:   ok = gen_rooms(out, faces, seed);                   break;
+    case GEN_SPHERE:  ok = gen_sphere(out, faces);                        break;
+    case GEN_TERRAIN: ok = gen_terrain(out, faces, seed);                 break;
+    case GEN_CLUTTER: ok = gen_triangles(out, faces, 20.0f, 4.0f, seed);  break;
+    default:
+        fprintf(stderr, "Unknown scene kind %d.\n", (int)kind);
+        return false;
+    }
+    if (ok) gen_fit(out);
+    return ok;
+}
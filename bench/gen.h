@@ -0,0 +1,31 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Deterministic synthetic scenes for benchmarking: the same kind, size and
+    seed always give the same pools.
+*******************************************************************************/
+
+#ifndef GEN_H
+#define GEN_H
+
+#include "../src/math.h" /* math_rand, shared by the bench tools */
+#include "../src/pools.h"
+
+typedef enum {
+    GEN_SOUP = 0,   /* Small random triangles scattered through a cube */
+    GEN_ROOMS,      /* Axis aligned box rooms on a floor plan */
+    GEN_SPHERE,     /* One tessellated sphere */
+    GEN_TERRAIN,    /* Height field grid */
+    GEN_CLUTTER,    /* Large triangles packed tight: most of them intersect */
+    GEN_COUNT
+} GEN_KIND;
+
+char const *gen_name(GEN_KIND kind);
+
+/* Fills empty pools with a scene of about `faces` faces, fewer where the
+ * kind would pass the 16 bit index limit. No planes are made. */
+bool gen_scene(pools *out, GEN_KIND kind, size_t faces, unsigned seed);
+
+#endif /* GEN_H */
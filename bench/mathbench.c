@@ -0,0 +1,759 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Microbenchmark of the geometric primitives in math.h. Each is timed under
+    each precision policy (double steps, float only, and float filtered by a
+    double recheck) and in branch-free lanes, over a cache resident set and
+    one far larger than the cache.
+    Throughput runs over independent inputs; latency chains each result into
+    the next input. Results are written as JSON alongside the bench runner's.
+*******************************************************************************/
+
+#include "../src/math.h"
+#include "../src/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MB_CACHED 1024U      /* Elements: all arrays fit in L1 / L2 */
+#define MB_STREAM (1U << 20) /* Elements: ~80 MB of arrays, past any LLC */
+#define MB_VERTS  0xFFFFU    /* Face vertex pool of the streaming set */
+#define MB_RUN    0.02       /* Seconds a timed run lasts at least */
+#define MB_RUNS   5U         /* Runs per measurement, the fastest kept */
+#define MB_LANES  PLANE_LANES
+#define MB_SEED   0xBE4CU
+
+typedef enum {
+    MB_DIST = 0,    /* vec3_distance_to_plane */
+    MB_PROJECT,     /* vec3_project_plane_get_d */
+    MB_RAY,         /* vec3_plane_ray_intersect */
+    MB_PLANE,       /* plane_from_face */
+} MB_PRIM;
+
+static char const *const mb_prim_names[] =
+    { "distance_to_plane", "project_plane_get_d", "plane_ray_intersect",
+      "plane_from_face" };
+
+/* Inputs and outputs, one element per primitive call. n is a multiple of
+ * MB_LANES so lane variants need no tail. */
+typedef struct {
+    char const    *name;
+    size_t         n, n_verts;
+    vert          *a, *b;        /* Points, segment ends */
+    plane         *planes;
+    face          *faces;
+    vert          *verts;
+    float         *dist;         /* Outputs */
+    vert          *pt;
+    unsigned char *ok;
+    plane         *pl;
+} mb_set;
+
+typedef struct {
+    MB_PRIM     prim;
+    char const *variant;
+    void      (*batch)(mb_set *);
+    float     (*chain)(mb_set *); /* NULL: lanes have no single latency */
+} mb_case;
+
+typedef struct {
+    mb_case const *c;
+    char const    *set;
+    double         thru, lat;     /* ns per call, lat < 0 when not run */
+    double         err;           /* Largest difference from double,
+                                     relative past magnitude 1 */
+} mb_result;
+
+static float volatile mb_sink;
+
+
+
+/* plane_from_face in float. Plane setup is outside the precision policy,
+ * but is timed alongside for comparison. */
+static bool
+mb_plane_f(plane *out, vert const *verts, face const *f)
+{
+    vert const *a = verts + f->i[0], *b = verts + f->i[2], *c = verts + f->i[1];
+    float e0[3], e1[3], n[3], mag;
+
+    vec3_sub(e0, b->m, a->m);
+    vec3_sub(e1, c->m, a->m);
+    vec3_cross(n, e0, e1);
+
+    out->rel = PLANE_REL_LEFT;
+    mag = vec3_dot(n, n);
+    if (mag < FLT_EPSILON)
+    {
+        memset(out->m, 0, sizeof(out->m));
+        out->d = 0.0f;
+        return false;
+    }
+    mag = sqrtf(mag);
+    out->m[0] = n[0] / mag;
+    out->m[1] = n[1] / mag;
+    out->m[2] = n[2] / mag;
+    out->d    = vec3_dot(out->m, a->m);
+    return true;
+}
+
+
+
+/* Independent calls give throughput. For latency each input takes the last
+ * result times zero, which the compiler cannot fold without fast math, so
+ * one call cannot start before the previous ends; the chaining op adds a
+ * few cycles. sfx picks the precision: _d, _f or _filtered; filtered
+ * intersections are the double ones. */
+#define MB_CALL_FNS(sfx)                                                      \
+static void                                                                   \
+dist##sfx(mb_set *s)                                                          \
+{                                                                             \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = 0; i < s->n; ++i)                                                \
+        s->dist[i] = vec3_distance_to_plane##sfx(s->planes + i, s->a[i].m);   \
+}                                                                             \
+                                                                              \
+static float                                                                  \
+dist##sfx##_chain(mb_set *s)                                                  \
+{                                                                             \
+    float c = 0.0f;                                                           \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = 0; i < s->n; ++i)                                                \
+    {                                                                         \
+        float const p[3] = { s->a[i].m[0] + c*0.0f, s->a[i].m[1],             \
+                             s->a[i].m[2] };                                  \
+                                                                              \
+        c = vec3_distance_to_plane##sfx(s->planes + i, p);                    \
+    }                                                                         \
+    return c;                                                                 \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+project##sfx(mb_set *s)                                                       \
+{                                                                             \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = 0; i < s->n; ++i)                                                \
+        s->dist[i] = vec3_project_plane_get_d##sfx(s->planes + i,             \
+                                                   s->pt[i].m, s->a[i].m);    \
+}                                                                             \
+                                                                              \
+static float                                                                  \
+project##sfx##_chain(mb_set *s)                                               \
+{                                                                             \
+    float c = 0.0f, o[3];                                                     \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = 0; i < s->n; ++i)                                                \
+    {                                                                         \
+        float const p[3] = { s->a[i].m[0] + c*0.0f, s->a[i].m[1],             \
+                             s->a[i].m[2] };                                  \
+                                                                              \
+        vec3_project_plane_get_d##sfx(s->planes + i, o, p);                   \
+        c = o[0];                                                             \
+    }                                                                         \
+    return c;                                                                 \
+}
+
+#define MB_RAY_FNS(sfx)                                                       \
+static void                                                                   \
+ray##sfx(mb_set *s)                                                           \
+{                                                                             \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = 0; i < s->n; ++i)                                                \
+        s->ok[i] = vec3_plane_ray_intersect##sfx(s->planes + i, s->pt[i].m,   \
+                                                 s->a[i].m, s->b[i].m);       \
+}                                                                             \
+                                                                              \
+static float                                                                  \
+ray##sfx##_chain(mb_set *s)                                                   \
+{                                                                             \
+    float c = 0.0f, o[3] = {0.0f};                                            \
+    size_t i;                                                                 \
+                                                                              \
+    for (i = 0; i < s->n; ++i)                                                \
+    {                                                                         \
+        float const p[3] = { s->a[i].m[0] + c*0.0f, s->a[i].m[1],             \
+                             s->a[i].m[2] };                                  \
+                                                                              \
+        vec3_plane_ray_intersect##sfx(s->planes + i, o, p, s->b[i].m);        \
+        c = o[0];                                                             \
+    }                                                                         \
+    return c;                                                                 \
+}
+
+MB_CALL_FNS(_d)
+MB_CALL_FNS(_f)
+MB_CALL_FNS(_filtered)
+MB_RAY_FNS(_d)
+MB_RAY_FNS(_f)
+
+#undef MB_CALL_FNS
+#undef MB_RAY_FNS
+
+static void
+plane_d(mb_set *s)
+{
+    size_t i;
+
+    for (i = 0; i < s->n; ++i)
+        s->ok[i] = plane_from_face(s->pl + i, s->verts, s->faces + i);
+}
+
+static void
+plane_f(mb_set *s)
+{
+    size_t i;
+
+    for (i = 0; i < s->n; ++i)
+        s->ok[i] = mb_plane_f(s->pl + i, s->verts, s->faces + i);
+}
+
+/* Faces are indexed, so the chain goes through the index: i ^ 0 unless the
+ * last plane came out NaN */
+static float
+plane_d_chain(mb_set *s)
+{
+    plane p;
+    size_t i;
+
+    memset(&p, 0, sizeof(p));
+    for (i = 0; i < s->n; ++i)
+        plane_from_face(&p, s->verts, s->faces + (i ^ (size_t)(p.d != p.d)));
+    return p.d;
+}
+
+static float
+plane_f_chain(mb_set *s)
+{
+    plane p;
+    size_t i;
+
+    memset(&p, 0, sizeof(p));
+    for (i = 0; i < s->n; ++i)
+        mb_plane_f(&p, s->verts, s->faces + (i ^ (size_t)(p.d != p.d)));
+    return p.d;
+}
+
+static void
+plane_lanes_d(mb_set *s)
+{
+    plane_from_faces(s->pl, s->ok, s->verts, s->faces, s->n);
+}
+
+
+
+/* Lanes: each group gathered into one array per component, then computed
+ * with selects rather than branches, as plane_from_faces does. T is the
+ * precision of every step. */
+#define MB_LANE_FNS(sfx, T, EPS)                                              \
+static void                                                                   \
+dist_lanes_##sfx(mb_set *s)                                                   \
+{                                                                             \
+    T px[MB_LANES], py[MB_LANES], pz[MB_LANES],                               \
+      nx[MB_LANES], ny[MB_LANES], nz[MB_LANES], nd[MB_LANES];                 \
+    size_t i, k;                                                              \
+                                                                              \
+    for (i = 0; i < s->n; i += MB_LANES)                                      \
+    {                                                                         \
+        for (k = 0; k < MB_LANES; ++k)                                        \
+        {                                                                     \
+            px[k] = s->a[i+k].m[0]; py[k] = s->a[i+k].m[1];                   \
+            pz[k] = s->a[i+k].m[2];                                           \
+            nx[k] = s->planes[i+k].m[0]; ny[k] = s->planes[i+k].m[1];         \
+            nz[k] = s->planes[i+k].m[2]; nd[k] = s->planes[i+k].d;            \
+        }                                                                     \
+        for (k = 0; k < MB_LANES; ++k)                                        \
+            s->dist[i+k] = (float)(px[k]*nx[k] + py[k]*ny[k] +                \
+                                   pz[k]*nz[k] - nd[k]);                      \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+project_lanes_##sfx(mb_set *s)                                                \
+{                                                                             \
+    T px[MB_LANES], py[MB_LANES], pz[MB_LANES],                               \
+      nx[MB_LANES], ny[MB_LANES], nz[MB_LANES], nd[MB_LANES];                 \
+    size_t i, k;                                                              \
+                                                                              \
+    for (i = 0; i < s->n; i += MB_LANES)                                      \
+    {                                                                         \
+        for (k = 0; k < MB_LANES; ++k)                                        \
+        {                                                                     \
+            px[k] = s->a[i+k].m[0]; py[k] = s->a[i+k].m[1];                   \
+            pz[k] = s->a[i+k].m[2];                                           \
+            nx[k] = s->planes[i+k].m[0]; ny[k] = s->planes[i+k].m[1];         \
+            nz[k] = s->planes[i+k].m[2]; nd[k] = s->planes[i+k].d;            \
+        }                                                                     \
+        for (k = 0; k < MB_LANES; ++k)                                        \
+        {                                                                     \
+            T const d = px[k]*nx[k] + py[k]*ny[k] + pz[k]*nz[k] - nd[k];      \
+                                                                              \
+            s->dist[i+k]    = (float)d;                                       \
+            s->pt[i+k].m[0] = (float)(px[k] - d*nx[k]);                       \
+            s->pt[i+k].m[1] = (float)(py[k] - d*ny[k]);                       \
+            s->pt[i+k].m[2] = (float)(pz[k] - d*nz[k]);                       \
+        }                                                                     \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+ray_lanes_##sfx(mb_set *s)                                                    \
+{                                                                             \
+    T ax[MB_LANES], ay[MB_LANES], az[MB_LANES],                               \
+      lx[MB_LANES], ly[MB_LANES], lz[MB_LANES],                               \
+      nx[MB_LANES], ny[MB_LANES], nz[MB_LANES], nd[MB_LANES];                 \
+    size_t i, k;                                                              \
+                                                                              \
+    for (i = 0; i < s->n; i += MB_LANES)                                      \
+    {                                                                         \
+        for (k = 0; k < MB_LANES; ++k)                                        \
+        {                                                                     \
+            ax[k] = s->a[i+k].m[0]; ay[k] = s->a[i+k].m[1];                   \
+            az[k] = s->a[i+k].m[2];                                           \
+            lx[k] = (T)s->b[i+k].m[0] - ax[k];                                \
+            ly[k] = (T)s->b[i+k].m[1] - ay[k];                                \
+            lz[k] = (T)s->b[i+k].m[2] - az[k];                                \
+            nx[k] = s->planes[i+k].m[0]; ny[k] = s->planes[i+k].m[1];         \
+            nz[k] = s->planes[i+k].m[2]; nd[k] = s->planes[i+k].d;            \
+        }                                                                     \
+        for (k = 0; k < MB_LANES; ++k)                                        \
+        {                                                                     \
+            T const ldN = lx[k]*nx[k] + ly[k]*ny[k] + lz[k]*nz[k];            \
+            T const g   = ldN >= EPS || ldN <= -EPS ? 1 : 0;                  \
+            T const a   = (nd[k] - (ax[k]*nx[k] + ay[k]*ny[k] +               \
+                                    az[k]*nz[k])) / (ldN + (1 - g)) * g;      \
+                                                                              \
+            s->pt[i+k].m[0] = (float)(ax[k] + a*lx[k]);                       \
+            s->pt[i+k].m[1] = (float)(ay[k] + a*ly[k]);                       \
+            s->pt[i+k].m[2] = (float)(az[k] + a*lz[k]);                       \
+            s->ok[i+k]      = g != 0;                                         \
+        }                                                                     \
+    }                                                                         \
+}
+
+MB_LANE_FNS(d, double, DBL_EPSILON)
+MB_LANE_FNS(f, float,  FLT_EPSILON)
+
+#undef MB_LANE_FNS
+
+/* plane_from_faces in float */
+static void
+plane_lanes_f(mb_set *s)
+{
+    float ax[MB_LANES], ay[MB_LANES], az[MB_LANES],
+          bx[MB_LANES], by[MB_LANES], bz[MB_LANES],
+          cx[MB_LANES], cy[MB_LANES], cz[MB_LANES];
+    size_t i, k;
+
+    for (i = 0; i < s->n; i += MB_LANES)
+    {
+        for (k = 0; k < MB_LANES; ++k)
+        {
+            face const *f = s->faces + i + k;
+            vert const *a = s->verts + f->i[0], *b = s->verts + f->i[2],
+                       *c = s->verts + f->i[1];
+
+            ax[k] = a->m[0]; ay[k] = a->m[1]; az[k] = a->m[2];
+            bx[k] = b->m[0]; by[k] = b->m[1]; bz[k] = b->m[2];
+            cx[k] = c->m[0]; cy[k] = c->m[1]; cz[k] = c->m[2];
+        }
+        for (k = 0; k < MB_LANES; ++k)
+        {
+            float const e0x = bx[k] - ax[k], e0y = by[k] - ay[k],
+                        e0z = bz[k] - az[k],
+                        e1x = cx[k] - ax[k], e1y = cy[k] - ay[k],
+                        e1z = cz[k] - az[k];
+            float x, y, z, mag, g;
+            plane *p = s->pl + i + k;
+
+            x   = (e0y*e1z) - (e0z*e1y);
+            y   = (e0z*e1x) - (e0x*e1z);
+            z   = (e0x*e1y) - (e0y*e1x);
+            mag = (x*x) + (y*y) + (z*z);
+            g   = mag >= FLT_EPSILON ? 1.0f : 0.0f;
+            mag = sqrtf(mag + (1.0f - g));
+            x   = x / mag * g;
+            y   = y / mag * g;
+            z   = z / mag * g;
+
+            p->m[0]    = x;
+            p->m[1]    = y;
+            p->m[2]    = z;
+            p->d       = (x*ax[k]) + (y*ay[k]) + (z*az[k]);
+            p->rel     = PLANE_REL_LEFT;
+            s->ok[i+k] = g != 0.0f;
+        }
+    }
+}
+
+/* The filtered policy in lanes: float throughout, then the few lanes within
+ * their rounding error of the band redone in double */
+static void
+dist_lanes_filtered(mb_set *s)
+{
+    float px[MB_LANES], py[MB_LANES], pz[MB_LANES],
+          nx[MB_LANES], ny[MB_LANES], nz[MB_LANES], nd[MB_LANES],
+          e[MB_LANES];
+    size_t i, k;
+
+    for (i = 0; i < s->n; i += MB_LANES)
+    {
+        unsigned redo = 0U;
+
+        for (k = 0; k < MB_LANES; ++k)
+        {
+            px[k] = s->a[i+k].m[0]; py[k] = s->a[i+k].m[1];
+            pz[k] = s->a[i+k].m[2];
+            nx[k] = s->planes[i+k].m[0]; ny[k] = s->planes[i+k].m[1];
+            nz[k] = s->planes[i+k].m[2]; nd[k] = s->planes[i+k].d;
+        }
+        for (k = 0; k < MB_LANES; ++k)
+        {
+            float const x = px[k]*nx[k], y = py[k]*ny[k], z = pz[k]*nz[k],
+                        d = x + y + z - nd[k];
+
+            s->dist[i+k] = d;
+            e[k] = fabsf(fabsf(d) - PLANE_EPSILON) -
+                   (fabsf(x) + fabsf(y) + fabsf(z) + fabsf(nd[k])) *
+                   PRECISION_FILTER;
+        }
+        for (k = 0; k < MB_LANES; ++k) redo |= e[k] <= 0.0f;
+        if (!redo) continue;
+        for (k = 0; k < MB_LANES; ++k)
+        {
+            if (e[k] <= 0.0f)
+                s->dist[i+k] = vec3_distance_to_plane_d(s->planes + i + k,
+                                                        s->a[i+k].m);
+        }
+    }
+}
+
+
+
+static mb_case const mb_cases[] = {
+    { MB_DIST,    "double",   dist_d,          dist_d_chain          },
+    { MB_DIST,    "float",    dist_f,          dist_f_chain          },
+    { MB_DIST,    "filtered", dist_filtered,   dist_filtered_chain   },
+    { MB_DIST,    "lanes_d",  dist_lanes_d,    NULL                  },
+    { MB_DIST,    "lanes_f",  dist_lanes_f,    NULL                  },
+    { MB_DIST,    "lanes_fd", dist_lanes_filtered, NULL              },
+    { MB_PROJECT, "double",   project_d,       project_d_chain       },
+    { MB_PROJECT, "float",    project_f,       project_f_chain       },
+    { MB_PROJECT, "filtered", project_filtered, project_filtered_chain },
+    { MB_PROJECT, "lanes_d",  project_lanes_d, NULL                  },
+    { MB_PROJECT, "lanes_f",  project_lanes_f, NULL                  },
+    { MB_RAY,     "double",   ray_d,           ray_d_chain           },
+    { MB_RAY,     "float",    ray_f,           ray_f_chain           },
+    { MB_RAY,     "lanes_d",  ray_lanes_d,     NULL                  },
+    { MB_RAY,     "lanes_f",  ray_lanes_f,     NULL                  },
+    { MB_PLANE,   "double",   plane_d,         plane_d_chain         },
+    { MB_PLANE,   "float",    plane_f,         plane_f_chain         },
+    { MB_PLANE,   "lanes_d",  plane_lanes_d,   NULL                  },
+    { MB_PLANE,   "lanes_f",  plane_lanes_f,   NULL                  },
+};
+#define MB_N_CASES (sizeof(mb_cases)/sizeof(*mb_cases))
+
+
+
+static void
+mb_set_free(mb_set *s)
+{
+    free(s->a);     free(s->b);
+    free(s->planes); free(s->faces); free(s->verts);
+    free(s->dist);  free(s->pt);    free(s->ok);    free(s->pl);
+    memset(s, 0, sizeof(*s));
+}
+
+/* Points in a 200 unit cube, unit normal planes through its middle half,
+ * segments up to 20 units long, and faces over a shared vertex pool */
+static bool
+mb_set_init(mb_set *s, char const *name, size_t n, size_t n_verts)
+{
+    unsigned seed = MB_SEED;
+    size_t i;
+    unsigned k;
+
+    memset(s, 0, sizeof(*s));
+    s->name    = name;
+    s->n       = n;
+    s->n_verts = n_verts;
+    s->a      = malloc(n * sizeof(*s->a));
+    s->b      = malloc(n * sizeof(*s->b));
+    s->planes = malloc(n * sizeof(*s->planes));
+    s->faces  = malloc(n * sizeof(*s->faces));
+    s->verts  = malloc(n_verts * sizeof(*s->verts));
+    s->dist   = malloc(n * sizeof(*s->dist));
+    s->pt     = malloc(n * sizeof(*s->pt));
+    s->ok     = malloc(n * sizeof(*s->ok));
+    s->pl     = malloc(n * sizeof(*s->pl));
+    if (!s->a || !s->b || !s->planes || !s->faces || !s->verts ||
+        !s->dist || !s->pt || !s->ok || !s->pl)
+    {
+        fprintf(stderr, "Failed to allocate the %s set.\n", name);
+        mb_set_free(s);
+        return false;
+    }
+
+    for (i = 0; i < n; ++i)
+    {
+        float m[3];
+
+        for (k = 0; k < 3; ++k)
+        {
+            s->a[i].m[k] = math_rand(&seed) * 200.0f - 100.0f;
+            s->b[i].m[k] = s->a[i].m[k] + math_rand(&seed) * 20.0f - 10.0f;
+            m[k] = math_rand(&seed) * 2.0f - 1.0f;
+        }
+        if (!vec3_norm(s->planes[i].m, m))
+        {
+            s->planes[i].m[0] = 1.0f;
+            s->planes[i].m[1] = s->planes[i].m[2] = 0.0f;
+        }
+        s->planes[i].d   = math_rand(&seed) * 100.0f - 50.0f;
+        s->planes[i].rel = PLANE_REL_LEFT;
+        for (k = 0; k < 3; ++k)
+            s->faces[i].i[k] = (unsigned short)(math_rand(&seed) * (n_verts-1));
+    }
+    for (i = 0; i < n_verts; ++i)
+        for (k = 0; k < 3; ++k)
+            s->verts[i].m[k] = math_rand(&seed) * 200.0f - 100.0f;
+
+    memset(s->dist, 0, n * sizeof(*s->dist));
+    memset(s->pt,   0, n * sizeof(*s->pt));
+    memset(s->ok,   0, n * sizeof(*s->ok));
+    memset(s->pl,   0, n * sizeof(*s->pl));
+    return true;
+}
+
+
+
+/* Seconds for reps passes, the fastest of MB_RUNS */
+static double
+mb_time(mb_case const *c, mb_set *s, bool latency, unsigned reps)
+{
+    double best = 0.0;
+    unsigned run, r;
+
+    for (run = 0; run < MB_RUNS; ++run)
+    {
+        double const t0 = timer_now();
+        double t;
+
+        for (r = 0; r < reps; ++r)
+        {
+            if (latency) mb_sink = c->chain(s);
+            else         c->batch(s);
+        }
+        t = timer_now() - t0;
+        if (!run || t < best) best = t;
+    }
+    return best;
+}
+
+/* ns per call, after doubling the passes per run until a run takes MB_RUN */
+static double
+mb_measure(mb_case const *c, mb_set *s, bool latency)
+{
+    unsigned reps = 1U;
+    double t;
+
+    for (;;)
+    {
+        double const t0 = timer_now();
+        unsigned r;
+
+        for (r = 0; r < reps; ++r)
+        {
+            if (latency) mb_sink = c->chain(s);
+            else         c->batch(s);
+        }
+        if (timer_now() - t0 >= MB_RUN || reps >= 1U << 24) break;
+        reps *= 2U;
+    }
+    t = mb_time(c, s, latency, reps);
+    return t * 1e9 / ((double)reps * (double)s->n);
+}
+
+/* Relative past magnitude 1, so near parallel rays hitting far away do not
+ * swamp the rest */
+static double
+mb_diff(float x, float y)
+{
+    double const e = fabs((double)x - y);
+
+    return fabs(y) > 1.0f ? e / fabs(y) : e;
+}
+
+static double
+mb_diff3(float const *x, float const *y)
+{
+    double e = 0.0;
+    unsigned k;
+
+    for (k = 0; k < 3; ++k)
+        if (mb_diff(x[k], y[k]) > e) e = mb_diff(x[k], y[k]);
+    return e;
+}
+
+/* Largest difference of this case's outputs from the double reference,
+ * over elements both consider valid */
+static double
+mb_error(MB_PRIM prim, mb_set const *s, mb_set const *ref)
+{
+    double e = 0.0, d;
+    size_t i;
+
+    for (i = 0; i < s->n; ++i)
+    {
+        switch (prim)
+        {
+        case MB_DIST:
+            d = mb_diff(s->dist[i], ref->dist[i]);
+            break;
+        case MB_PROJECT:
+            d = mb_diff(s->dist[i], ref->dist[i]);
+            if (mb_diff3(s->pt[i].m, ref->pt[i].m) > d)
+                d = mb_diff3(s->pt[i].m, ref->pt[i].m);
+            break;
+        case MB_RAY:
+            d = s->ok[i] && ref->ok[i] ? mb_diff3(s->pt[i].m, ref->pt[i].m)
+                                       : 0.0;
+            break;
+        default:
+            d = 0.0;
+            if (s->ok[i] && ref->ok[i])
+            {
+                d = mb_diff3(s->pl[i].m, ref->pl[i].m);
+                if (mb_diff(s->pl[i].d, ref->pl[i].d) > d)
+                    d = mb_diff(s->pl[i].d, ref->pl[i].d);
+            }
+            break;
+        }
+        if (d > e) e = d;
+    }
+    return e;
+}
+
+/* Runs every case over the set, checking outputs against the double case
+ * run just before it */
+static size_t
+mb_run_set(mb_set *s, mb_result *out)
+{
+    mb_set ref;
+    size_t i, n = 0U;
+
+    if (!mb_set_init(&ref, "reference", s->n, s->n_verts)) return 0U;
+    memcpy(ref.verts, s->verts, s->n_verts * sizeof(*s->verts));
+
+    for (i = 0; i < MB_N_CASES; ++i, ++n)
+    {
+        mb_case const *c = mb_cases + i;
+        mb_result *r = out + n;
+
+        r->c    = c;
+        r->set  = s->name;
+        r->thru = mb_measure(c, s, false);
+        r->lat  = c->chain ? mb_measure(c, s, true) : -1.0;
+
+        if (!strcmp(c->variant, "double"))
+        {
+            memcpy(ref.dist, s->dist, s->n * sizeof(*s->dist));
+            memcpy(ref.pt,   s->pt,   s->n * sizeof(*s->pt));
+            memcpy(ref.ok,   s->ok,   s->n * sizeof(*s->ok));
+            memcpy(ref.pl,   s->pl,   s->n * sizeof(*s->pl));
+        }
+        r->err = mb_error(c->prim, s, &ref);
+
+        printf("%-20s %-8s %-7s %8.3f ns", mb_prim_names[c->prim],
+               c->variant, s->name, r->thru);
+        if (r->lat >= 0.0) printf("  %8.3f ns", r->lat);
+        else               printf("  %8s   ", "-");
+        printf("  %.3g\n", r->err);
+        fflush(stdout);
+    }
+    mb_set_free(&ref);
+    return n;
+}
+
+
+
+static void
+mb_json(FILE *f, mb_result const *r, size_t n, size_t cached, size_t stream)
+{
+    size_t i;
+
+    fprintf(f, "{\n  \"version\": 1,\n  \"lanes\": %u,\n"
+               "  \"cached_elements\": %zu,\n  \"stream_elements\": %zu,\n"
+               "  \"results\": [", MB_LANES, cached, stream);
+    for (i = 0; i < n; ++i, ++r)
+    {
+        fprintf(f, "%s\n    {\"primitive\": \"%s\", \"variant\": \"%s\", "
+                   "\"set\": \"%s\", \"throughput_ns\": %.4f, ",
+                i ? "," : "", mb_prim_names[r->c->prim], r->c->variant,
+                r->set, r->thru);
+        if (r->lat >= 0.0) fprintf(f, "\"latency_ns\": %.4f, ", r->lat);
+        else               fprintf(f, "\"latency_ns\": null, ");
+        fprintf(f, "\"max_error\": %.6g}", r->err);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage:\n  bsp_mathbench [-s stream_elements] "
+                    "[-o out.json]\n"
+                    "    -s  elements in the streaming set (default %u)\n"
+                    "    -o  results file (default mathbench.json)\n",
+                    MB_STREAM);
+}
+
+int main(int argc, char **argv)
+{
+    mb_result r[2 * MB_N_CASES];
+    char const *out = "mathbench.json";
+    size_t stream = MB_STREAM, n = 0U;
+    mb_set s;
+    FILE *f;
+
+    for (; argc > 2 && argv[1][0] == '-'; argv += 2, argc -= 2)
+    {
+        if      (!strcmp(argv[1], "-s")) stream = strtoul(argv[2], NULL, 10);
+        else if (!strcmp(argv[1], "-o")) out = argv[2];
+        else break;
+    }
+    stream -= stream % MB_LANES;
+    if (argc != 1 || !stream)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    printf("%-20s %-8s %-7s %11s  %11s  %s\n", "primitive", "variant", "set",
+           "throughput", "latency", "max error");
+
+    /* The cached set's faces index only its own few verts */
+    if (!mb_set_init(&s, "cached", MB_CACHED, MB_CACHED)) return EXIT_FAILURE;
+    n += mb_run_set(&s, r + n);
+    mb_set_free(&s);
+
+    if (!mb_set_init(&s, "stream", stream, MB_VERTS)) return EXIT_FAILURE;
+    n += mb_run_set(&s, r + n);
+    mb_set_free(&s);
+
+    if (!(f = fopen(out, "w")))
+    {
+        fprintf(stderr, "Failed to open \"%s\" for writing.\n", out);
+        return EXIT_FAILURE;
+    }
+    mb_json(f, r, n, MB_CACHED, stream);
+    fclose(f);
+    printf("Results written to \"%s\".\n", out);
+    return EXIT_SUCCESS;
+}
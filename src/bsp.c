@@ -7,6 +7,8 @@
 *******************************************************************************/
 
 #include "bsp.h"
+#include "math.h"
+#include "mem.h"
 #include "verbose.h"
 
 #include <stdio.h>
@@ -22,6 +24,25 @@ extern pools g_pool;
 
 
 
+/* Accounts for capacity changed from old nodes */
+static void
+bsp_account_(SELF, size_t old)
+{
+    mem_track(MEM_NODES, old * sizeof(bsp_node),  self->cap * sizeof(bsp_node));
+    mem_track(MEM_BOXES, old * sizeof(bsp_box),   self->cap * sizeof(bsp_box));
+}
+
+/* Boxes not yet bounded by a build cull nothing */
+static void
+bsp_box_unbounded_(bsp_box *b, size_t n)
+{
+    for (; n; --n, ++b)
+    {
+        b->min[0] = b->min[1] = b->min[2] = -FLT_MAX;
+        b->max[0] = b->max[1] = b->max[2] =  FLT_MAX;
+    }
+}
+
 bool
 bsp_alloc(SELF_PARAM(bsp)   out,
           SELF_PARAM(pools) pool)
@@ -64,9 +85,11 @@ bsp_alloc(SELF_PARAM(bsp)   out,
     bsp_free(out);
 
     cap = pool->n_faces << 1;
-    out->d = malloc(cap * sizeof(bsp_node));
-    if (!out->d)
+    out->d   = malloc(cap * sizeof(bsp_node));
+    out->box = malloc(cap * sizeof(bsp_box));
+    if (!out->d || !out->box)
     {
+        bsp_free(out);
         VERBOSE_2
         (
             fprintf(stderr, "Insufficient memory for BSP.\n");
@@ -74,7 +97,9 @@ bsp_alloc(SELF_PARAM(bsp)   out,
         return false;
     }
     out->cap = cap;
+    bsp_account_(out, 0U);
     memset(out->d, 0xFF, cap * sizeof(bsp_node));
+    bsp_box_unbounded_(out->box, cap);
 
     return true;
 }
@@ -86,6 +111,7 @@ bsp_realloc_(SELF, size_t cap)
 {
     size_t old, init;
     bsp_node *reloc;
+    bsp_box  *box;
 
     if (!self)
     {
@@ -116,7 +142,7 @@ bsp_realloc_(SELF, size_t cap)
 
     init = cap < old ? 0U : (cap - old);
 
-    reloc = realloc(self->d, cap);
+    reloc = realloc(self->d, cap * sizeof(bsp_node));
     if (!reloc)
     {
         VERBOSE_2
@@ -127,9 +153,21 @@ bsp_realloc_(SELF, size_t cap)
     }
 
     memset(reloc + old, 0xFF, init * sizeof(bsp_node));
+    self->d = reloc;
 
-    self->d   = reloc;
+    box = realloc(self->box, cap * sizeof(bsp_box));
+    if (!box)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "ERROR (OOM): bsp_realloc()\n");
+        )
+        return false;
+    }
+    if (init) bsp_box_unbounded_(box + old, init);
+    self->box = box;
     self->cap = cap;
+    bsp_account_(self, old);
     if (!init && self->occ > cap)
     {
         VERBOSE_2
@@ -156,6 +194,8 @@ void bsp_clear(SELF)
 {
     if (self && self->d)
         memset(self->d, 0xFF, self->cap * sizeof(bsp_node));
+    if (self && self->box)
+        bsp_box_unbounded_(self->box, self->cap);
 }
 
 
@@ -163,9 +203,24 @@ void bsp_clear(SELF)
 void
 bsp_free(SELF)
 {
+    size_t cap;
+
     if (!self) return;
+    cap = self->cap;
     free(self->d);
+    free(self->box);
     bsp_init(self);
+    bsp_account_(self, cap);
+}
+
+
+
+bool
+bsp_shrink(SELF)
+{
+    if (!self) return false;
+    if (!self->occ || self->occ == self->cap) return true;
+    return bsp_realloc_(self, self->occ);
 }
 
 
@@ -369,3 +424,157 @@ bsp_node_get_plane(SELF_PARAM(pools) self, bsp_ind id)
 
     return self->planes + id;
 }
+
+
+
+/* In-order walk: the child away from the eye comes first when drawing back
+ * to front, the one holding it comes first front to back */
+static inline bool
+bsp_order_right_first(pools const *pool, bsp_node const *n,
+                      float const *eye, BSP_ORDER order)
+{
+    bool const behind = vec3_distance_to_plane(pool->planes + n->pl, eye) < 0.0f;
+    return behind == (order == BSP_ORDER_BACK_TO_FRONT);
+}
+
+/* True if the face lies wholly outside one of the planes in mask */
+static inline bool
+bsp_face_clipped(pools const *pool, unsigned short i,
+                 plane const *clip, unsigned short mask)
+{
+    float const *v0 = pool->verts[pool->faces[i].i[0]].m;
+    float const *v1 = pool->verts[pool->faces[i].i[1]].m;
+    float const *v2 = pool->verts[pool->faces[i].i[2]].m;
+    unsigned k;
+
+    for (k = 0; mask; ++k, mask >>= 1)
+    {
+        if ((mask & 1U) &&
+            vec3_distance_to_plane(clip + k, v0) < 0.0f &&
+            vec3_distance_to_plane(clip + k, v1) < 0.0f &&
+            vec3_distance_to_plane(clip + k, v2) < 0.0f)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* True if the subtree's box lies wholly outside one of the planes in *mask.
+ * Planes it lies wholly inside are dropped from *mask: they cannot clip
+ * anything further down. */
+static inline bool
+bsp_node_clipped(bsp const *self, bsp_ind id,
+                 plane const *clip, unsigned short *mask)
+{
+    bsp_box const *b = self->box + id;
+    unsigned short m = *mask;
+    unsigned k;
+
+    for (k = 0; m; ++k, m >>= 1)
+    {
+        plane const *p = clip + k;
+        float c[3];
+
+        if (!(m & 1U)) continue;
+        if (bsp_box_outside(b, p)) return true;
+
+        /* Nearest corner inside too */
+        c[0] = p->m[0] >= 0.0f ? b->min[0] : b->max[0];
+        c[1] = p->m[1] >= 0.0f ? b->min[1] : b->max[1];
+        c[2] = p->m[2] >= 0.0f ? b->min[2] : b->max[2];
+        if (vec3_distance_to_plane(p, c) >= 0.0f)
+            *mask &= (unsigned short)~(1U << k);
+    }
+    return false;
+}
+
+size_t
+bsp_order(SELF_PARAM(bsp)   self,
+          SELF_PARAM(pools) pool,
+          float const      *eye,
+          BSP_ORDER         order,
+          bsp_visit        *stack,
+          size_t            n_stack,
+          unsigned short   *out,
+          size_t            cap)
+{
+    return bsp_order_clipped(self, pool, eye, NULL, 0U, order,
+                             stack, n_stack, out, cap);
+}
+
+size_t
+bsp_order_clipped(SELF_PARAM(bsp)   self,
+                  SELF_PARAM(pools) pool,
+                  float const      *eye,
+                  plane const      *clip,
+                  unsigned          n_clip,
+                  BSP_ORDER         order,
+                  bsp_visit        *stack,
+                  size_t            n_stack,
+                  unsigned short   *out,
+                  size_t            cap)
+{
+    bsp_node const *n;
+    size_t sp = 0U, count = 0U;
+    bsp_ind id = 0;
+    unsigned short i, mask;
+
+    if (!self || !self->d || !pool || !pool->planes || !eye || !stack ||
+        !out  || (n_clip && (!clip || !self->box)))
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: bsp_order() without tree, pool, eye, "
+                            "clipping planes, stack or output.\n");
+        )
+        return 0U;
+    }
+    if (n_clip > BSP_CLIP_MAX)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: bsp_order_clipped() with %u planes, "
+                            "using the first %u.\n", n_clip, BSP_CLIP_MAX);
+        )
+        n_clip = BSP_CLIP_MAX;
+    }
+    mask = (unsigned short)((1UL << n_clip) - 1U);
+
+    for (;;)
+    {
+        /* Descend the first sides, then emit and turn to the second */
+        while (id < self->occ)
+        {
+            if (mask && bsp_node_clipped(self, id, clip, &mask)) break;
+            if (sp == n_stack)
+            {
+                VERBOSE_2
+                (
+                    fprintf(stderr, "WARNING: bsp_order() stack of %zu "
+                                    "entries is too shallow.\n", n_stack);
+                )
+                return count;
+            }
+            n = self->d + id;
+            stack[sp].id   = id;
+            stack[sp].mask = mask;
+            ++sp;
+            id = bsp_order_right_first(pool, n, eye, order) ? n->r : n->l;
+        }
+        if (!sp) break;
+
+        --sp;
+        n    = self->d + stack[sp].id;
+        mask = stack[sp].mask;
+        for (i = n->pl; i <= n->pr; ++i)
+        {
+            if (mask && bsp_face_clipped(pool, i, clip, mask)) continue;
+            if (count >= cap) return count;
+            out[count++] = i;
+        }
+        id = bsp_order_right_first(pool, n, eye, order) ? n->l : n->r;
+    }
+
+    return count;
+}
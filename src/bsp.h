@@ -30,11 +30,28 @@ typedef struct {
                  * (polygon vector index range, inclusive) */
 } bsp_node;
 
+typedef struct {
+    float min[3], max[3];
+} bsp_box;
+
+#define BSP_CLIP_MAX 16 /* Clipping planes one traversal can carry */
+
+typedef struct {
+    bsp_ind        id;
+    unsigned short mask; /* Clipping planes still to test below this node */
+} bsp_visit;
+
 typedef struct {
     size_t occ, cap;
     bsp_node *d;
+    bsp_box  *box; /* Bounds of each node's subtree (parallel to d) */
 } bsp;
 
+typedef enum {
+    BSP_ORDER_BACK_TO_FRONT = 0,
+    BSP_ORDER_FRONT_TO_BACK,
+} BSP_ORDER;
+
 
 
 static inline void
@@ -43,9 +60,32 @@ bsp_init(SELF)
     if (!self) return;
 
     self->d   = NULL;
+    self->box = NULL;
     self->occ = self->cap = 0U;
 }
 
+/* True if the boxes share any point */
+static inline bool
+bsp_box_overlap(bsp_box const *a, bsp_box const *b)
+{
+    return a->min[0] <= b->max[0] && a->max[0] >= b->min[0] &&
+           a->min[1] <= b->max[1] && a->max[1] >= b->min[1] &&
+           a->min[2] <= b->max[2] && a->max[2] >= b->min[2];
+}
+
+/* True if the box lies wholly on the negative side of the plane */
+static inline bool
+bsp_box_outside(bsp_box const *b, plane const *p)
+{
+    float const c[3] =
+    {
+        p->m[0] >= 0.0f ? b->max[0] : b->min[0],
+        p->m[1] >= 0.0f ? b->max[1] : b->min[1],
+        p->m[2] >= 0.0f ? b->max[2] : b->min[2],
+    };
+    return p->m[0]*c[0] + p->m[1]*c[1] + p->m[2]*c[2] - p->d < 0.0f;
+}
+
 bool
 bsp_alloc(SELF_PARAM(bsp)   out,
           SELF_PARAM(pools) pool);
@@ -53,6 +93,9 @@ bsp_alloc(SELF_PARAM(bsp)   out,
 void bsp_free (SELF);
 void bsp_clear(SELF);
 
+/* Cuts capacity to the nodes in use; later nodes grow it again */
+bool bsp_shrink(SELF);
+
 bsp_ind bsp_new         (SELF, bsp_ind     pl, bsp_ind    pr);
    void bsp_insert_left (SELF, bsp_ind parent, bsp_ind child);
    void bsp_insert_right(SELF, bsp_ind parent, bsp_ind child);
@@ -69,5 +112,34 @@ plane *
 bsp_node_get_plane(SELF_PARAM(pools) self,
                              bsp_ind id);
 
+/* Writes at most cap face indices into out[], ordered by distance from the
+ * eye, and returns how many were written. The walk keeps its place in the
+ * caller's stack of n_stack entries (the tree depth, or occ, is enough):
+ * nothing is allocated, and walks over one tree may run at once. */
+size_t
+bsp_order(SELF_PARAM(bsp)   self,
+          SELF_PARAM(pools) pool,
+          float const      *eye,
+          BSP_ORDER         order,
+          bsp_visit        *stack,
+          size_t            n_stack,
+          unsigned short   *out,
+          size_t            cap);
+
+/* As bsp_order, leaving out subtrees and faces wholly outside any of the
+ * n_clip (at most BSP_CLIP_MAX) planes, e.g. the camera frustum from
+ * camera_get_frustum. Subtrees wholly inside a plane stop testing it. */
+size_t
+bsp_order_clipped(SELF_PARAM(bsp)   self,
+                  SELF_PARAM(pools) pool,
+                  float const      *eye,
+                  plane const      *clip,
+                  unsigned          n_clip,
+                  BSP_ORDER         order,
+                  bsp_visit        *stack,
+                  size_t            n_stack,
+                  unsigned short   *out,
+                  size_t            cap);
+
 #undef SELF
 #endif /* PART_H */
@@ -39,6 +39,7 @@ camera_reset(void)
     g_cam.asp = window_get_aspect_ratio();
     g_cam.nearp = 0.1f;
     g_cam.farp  = 128.1f;
+    g_mat_dirty = g_proj_params_dirty = true;
 }
 
 
@@ -47,6 +48,7 @@ void
 camera_snap(float const *pos)
 {
     memcpy(g_cam.pos, pos, sizeof(g_cam.pos));
+    g_mat_dirty = true;
 }
 
 void
@@ -55,6 +57,7 @@ camera_turn(float const *ori)
     g_cam.ori[0] += ori[0];
     g_cam.ori[1] += ori[1];
     g_cam.ori[2] += ori[2];
+    g_mat_dirty = true;
 }
 
 
@@ -256,6 +259,48 @@ camera_get_matrix(float *out)
 
 
 
+void
+camera_get_frustum(plane *out)
+{
+    /* Rows of g_proj * g_mat (column major), as in Gribb & Hartmann.
+     * Near uses the GL clip volume (-w <= z), which holds the 0..1 one. */
+    static signed char const rows[6][2] =
+    {
+        { 0,  1 }, { 0, -1 }, /* Left,   right */
+        { 1,  1 }, { 1, -1 }, /* Bottom, top   */
+        { 2,  1 }, { 2, -1 }, /* Near,   far   */
+    };
+    double m[16], n[4], len;
+    unsigned char i, j, k;
+
+    if (!out) return;
+    camera_clean();
+
+    for (j = 0; j < 4; ++j)
+    for (i = 0; i < 4; ++i)
+    {
+        m[i + 4*j] = 0.0;
+        for (k = 0; k < 4; ++k)
+            m[i + 4*j] += (double)g_proj[i + 4*k] * (double)g_mat[k + 4*j];
+    }
+
+    for (k = 0; k < 6; ++k)
+    {
+        for (j = 0; j < 4; ++j)
+            n[j] = m[3 + 4*j] + rows[k][1] * m[rows[k][0] + 4*j];
+
+        len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (len <= 0.0) len = 1.0;
+
+        out[k].m[0] = (float)( n[0] / len);
+        out[k].m[1] = (float)( n[1] / len);
+        out[k].m[2] = (float)( n[2] / len);
+        out[k].d    = (float)(-n[3] / len);
+    }
+}
+
+
+
 void
 camera_update(float delta)
 {
@@ -313,6 +358,12 @@ camera_unset(CAM_DIR d)
     g_camdir &= ~d;
 }
 
+bool
+camera_moving(void)
+{
+    return g_camdir != 0;
+}
+
 
 
 float
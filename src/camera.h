@@ -10,6 +10,10 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include "plane.h"
+
+#include <stdbool.h>
+
 #define CAM_ORI_PITCH 0
 #define CAM_ORI_YAW   1
 #define CAM_ORI_ROLL  2
@@ -49,12 +53,14 @@ void camera_set_asp (float asp  );
 
 void camera_set  (CAM_DIR);
 void camera_unset(CAM_DIR);
+bool camera_moving(void); /* Any direction held */
 
 void camera_snap (float const *pos);
 void camera_turn (float const *ori);
 
 void camera_clean(void);
 void camera_get_matrix(float *out);
+void camera_get_frustum(plane *out); /* Six planes, the inside positive */
 
 static inline float  *camera_ptr_matrix     (void) { return g_mat; }
 static inline float  *camera_ptr_proj_matrix(void) { return g_proj; }
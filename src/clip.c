@@ -8,7 +8,6 @@
 *******************************************************************************/
 
 #include "clip.h"
-#include "draw.h"
 #include "math.h"
 #include "verbose.h"
 
@@ -18,40 +17,6 @@
 
 
 
-extern unsigned   int clips;
-extern unsigned short g_poly_clip, g_poly_inter, g_vert_012[3];
-extern      DRAW_MODE g_draw_mode;
-//extern           bool g_draw_clip;
-
-
-
-static void
-clip_draw(pools        *pool,
-           face        *in,
-          plane const  *clipper,
-           vert const **vs)
-{
-    g_draw_mode = DRAW_MODE_CLIP;
-    g_poly_clip = clipper - pool->planes;
-    g_poly_inter = in - pool->faces;
-    if (vs)
-    {
-        g_vert_012[0] = vs[0] - pool->verts;
-        g_vert_012[1] = vs[1] - pool->verts;
-        g_vert_012[2] = vs[2] - pool->verts;
-    }
-    else
-    {
-        g_vert_012[0] = 0xFFFF;
-        g_vert_012[1] = 0xFFFF;
-        g_vert_012[2] = 0xFFFF;
-    }
-    draw_pause();
-    g_draw_mode = DRAW_MODE_UNSPECIFIED;
-}
-
-
-
 bool
 clip_face(clip_pivot       *pivot,
                pools       *pool,
@@ -63,6 +28,7 @@ clip_face(clip_pivot       *pivot,
     
     face *in;
     plane *clipper;
+    plane in_p; /* Inserting faces shifts the pool; keep the source plane */
 
     VERBOSE_2(float nm[2][3];)
     
@@ -81,11 +47,12 @@ clip_face(clip_pivot       *pivot,
     }
     *advance = 0;
     
-    /* Prepare buffers */
-    if (!pools_vert_declare(pool, 2) ||
-        !pools_face_declare(pool, 2))
+    /* Room for the split is reserved per node by select_iter */
+    if (pool->n_verts + 2 > pool->c_verts ||
+        pool->n_faces + 2 > pool->c_faces)
     {
-        fprintf(stderr, "Clipping error: Could not accommodate new polygons.\n");
+        fprintf(stderr, "Clipping error: Split was not reserved.\n");
+        VERBOSE_1(raise(SIGINT);)
         return false;
     }
     
@@ -103,6 +70,7 @@ clip_face(clip_pivot       *pivot,
     verts  = pool->verts;
     nverts = pool->n_verts;
     in     = pool->faces + face_i;
+    in_p   = pool->planes[face_i];
     clipper = pool->planes + clipper_i;
     
     if (in->i[0] >= nverts)
@@ -165,17 +133,17 @@ clip_face(clip_pivot       *pivot,
     e[0][2]=e[1][0]
 
     /* Determine intersection type and reorder vertex pointers */
-    if (e[0][0] <= -FLT_EPSILON) /* v0 < p */
+    if (e[0][0] <= -PLANE_EPSILON) /* v0 < p */
     {
         VERBOSE_3(fprintf(stderr, "v0 behind clipper\n");)
         
-        if (e[0][1] <= -FLT_EPSILON) /* v0 v1 < p */
+        if (e[0][1] <= -PLANE_EPSILON) /* v0 v1 < p */
         {
             two = true;
 
             VERBOSE_3(fprintf(stderr, "v1 behind clipper\n");)
 
-            if (e[0][2] < FLT_EPSILON) /* v0 v1 < v2 <= p */
+            if (e[0][2] < PLANE_EPSILON) /* v0 v1 < v2 <= p */
             {
                 /* No intersection */
                 VERBOSE_2
@@ -196,11 +164,11 @@ clip_face(clip_pivot       *pivot,
                 VERT_ROT_CW;
             }
         }
-        else if (e[0][1] >= FLT_EPSILON) /* v0 < p < v1 */
+        else if (e[0][1] >= PLANE_EPSILON) /* v0 < p < v1 */
         {
             VERBOSE_3(fprintf(stderr, "v1 ahead of clipper\n");)
         
-            if (e[0][2] <= -FLT_EPSILON) /* v0 v2 < p < v1 */
+            if (e[0][2] <= -PLANE_EPSILON) /* v0 v2 < p < v1 */
             {
                 two = true;
 
@@ -211,7 +179,7 @@ clip_face(clip_pivot       *pivot,
                 )
                 VERT_ROT_CCW;
             }
-            else if (e[0][2] >= FLT_EPSILON) /* v0 < p < v1 v2 */
+            else if (e[0][2] >= PLANE_EPSILON) /* v0 < p < v1 v2 */
             {
                 two = true;
                 left_light = true;
@@ -242,7 +210,7 @@ clip_face(clip_pivot       *pivot,
         {
             VERBOSE_3(fprintf(stderr, "v1 clips\n");)
             
-            if (e[0][2] < FLT_EPSILON) /* v0 < (p == v1) <= v2 */
+            if (e[0][2] < PLANE_EPSILON) /* v0 < (p == v1) <= v2 */
             {
                 VERBOSE_3
                 (
@@ -261,17 +229,17 @@ clip_face(clip_pivot       *pivot,
             VERT_ROT_CCW;
         }
     }
-    else if (e[0][0] >= FLT_EPSILON) /* p < v0 */
+    else if (e[0][0] >= PLANE_EPSILON) /* p < v0 */
     {
         VERBOSE_3(fprintf(stderr, "v0 ahead of clipper\n");)
 
-        if (e[0][1] >= FLT_EPSILON) /* p < v0 v1 */
+        if (e[0][1] >= PLANE_EPSILON) /* p < v0 v1 */
         {
             two = true;
 
             VERBOSE_3(fprintf(stderr, "v1 ahead of clipper\n");)
 
-            if (e[0][2] > -FLT_EPSILON) /* p < v0 v1 v2 */
+            if (e[0][2] > -PLANE_EPSILON) /* p < v0 v1 v2 */
             {
                 /* No intersection */
                 VERBOSE_2
@@ -295,11 +263,11 @@ clip_face(clip_pivot       *pivot,
                 VERT_ROT_CW;
             }
         }
-        else if (e[0][1] <= -FLT_EPSILON) /* v1 < p < v0 */
+        else if (e[0][1] <= -PLANE_EPSILON) /* v1 < p < v0 */
         {
             VERBOSE_3(fprintf(stderr, "v1 behind clipper\n");)
             
-            if (e[0][2] <= -FLT_EPSILON) /* v1 v2 < p < v0 */
+            if (e[0][2] <= -PLANE_EPSILON) /* v1 v2 < p < v0 */
             {
                 two = true;
                 
@@ -311,7 +279,7 @@ clip_face(clip_pivot       *pivot,
 
                 /* PERFECT ORDERING HERE. No rotation necessary */
             }
-            else if (e[0][2] >= FLT_EPSILON) /* v1 < p < v0 v2 */
+            else if (e[0][2] >= PLANE_EPSILON) /* v1 < p < v0 v2 */
             {
                 two = true;
                 left_light = true;
@@ -341,7 +309,7 @@ clip_face(clip_pivot       *pivot,
         {
             VERBOSE_3(fprintf(stderr, "v1 clips\n");)
             
-            if (e[0][2] > -FLT_EPSILON) /* (p == v1) <= v2 < v0 */
+            if (e[0][2] > -PLANE_EPSILON) /* (p == v1) <= v2 < v0 */
             {
                 VERBOSE_2
                 (
@@ -366,11 +334,11 @@ clip_face(clip_pivot       *pivot,
         VERBOSE_3(fprintf(stderr, "v0 clips\n");)
         
         two = false;
-        if (e[0][1] <= -FLT_EPSILON)
+        if (e[0][1] <= -PLANE_EPSILON)
         {
             VERBOSE_3(fprintf(stderr, "v1 behind clipper\n");)
             
-            if (e[0][2] < FLT_EPSILON)
+            if (e[0][2] < PLANE_EPSILON)
             {
                 VERBOSE_2
                 (
@@ -384,11 +352,11 @@ clip_face(clip_pivot       *pivot,
             VERBOSE_3(fprintf(stderr, "v2 ahead of clipper\n");)
             left_light = true;
         }
-        else if(e[0][1] >= FLT_EPSILON)
+        else if(e[0][1] >= PLANE_EPSILON)
         {
             VERBOSE_3(fprintf(stderr, "v1 ahead of clipper\n");)
             
-            if (e[0][2] > -FLT_EPSILON)
+            if (e[0][2] > -PLANE_EPSILON)
             {
                 VERBOSE_2
                 (
@@ -409,8 +377,6 @@ clip_face(clip_pivot       *pivot,
     }
 #undef VERT_ROT
 
-    clip_draw(pool, in, clipper, v);
-
     /* Derive normal */
 #if VERBOSE >= 2
     normal_from_face(&nm[1][0], verts, in, false);
@@ -426,8 +392,8 @@ clip_face(clip_pivot       *pivot,
     {
         if (left_light)
         {
-            if( e[0][0] <= -FLT_EPSILON &&
-                e[0][1] >=  FLT_EPSILON && e[0][2] >=  FLT_EPSILON ) {}
+            if( e[0][0] <= -PLANE_EPSILON &&
+                e[0][1] >=  PLANE_EPSILON && e[0][2] >=  PLANE_EPSILON ) {}
             else
             {
                 fprintf(stderr, "Assertion failure (two && left_light).\n");
@@ -437,8 +403,8 @@ clip_face(clip_pivot       *pivot,
         }
         else
         {
-            if( e[0][0] >=  FLT_EPSILON &&
-                e[0][1] <= -FLT_EPSILON && e[0][2] <= -FLT_EPSILON ) {}
+            if( e[0][0] >=  PLANE_EPSILON &&
+                e[0][1] <= -PLANE_EPSILON && e[0][2] <= -PLANE_EPSILON ) {}
             else
             {
                 fprintf(stderr, "Assertion failure (two && !left_light).\n");
@@ -449,7 +415,7 @@ clip_face(clip_pivot       *pivot,
     }
     else
     {
-        if (fabs(e[0][0]) < FLT_EPSILON) {}
+        if (fabs(e[0][0]) < PLANE_EPSILON) {}
         else
         {
             fprintf(stderr, "Assertion failure (!two && !clipping epsilon).\n");
@@ -458,8 +424,8 @@ clip_face(clip_pivot       *pivot,
         }
         if (left_light)
         {
-            if (   e[0][1] <= -FLT_EPSILON &&
-                   e[0][2] >=  FLT_EPSILON) {}
+            if (   e[0][1] <= -PLANE_EPSILON &&
+                   e[0][2] >=  PLANE_EPSILON) {}
             else
             {
                 fprintf(stderr, "Assertion failure (!two && left_light).\n");
@@ -469,8 +435,8 @@ clip_face(clip_pivot       *pivot,
         }
         else
         {
-            if (   e[0][1] >=  FLT_EPSILON &&
-                   e[0][2] <= -FLT_EPSILON) {}
+            if (   e[0][1] >=  PLANE_EPSILON &&
+                   e[0][2] <= -PLANE_EPSILON) {}
             else
             {
                 fprintf(stderr, "Assertion failure (!two && !left_light).\n");
@@ -535,24 +501,22 @@ clip_face(clip_pivot       *pivot,
                 nf.i[0] = v[2] - verts; // Right
                 nf.i[1] = ev1;
                 nf.i[2] = ev0;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             face_i+1))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->r;
                 ++ (*advance);
                 
                 nf.i[0] = v[0] - verts; // Left
                 nf.i[1] = ev0;
                 nf.i[2] = ev1;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pl))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->pl;
                 ++ pivot->pr;
                 ++ pivot->r;
@@ -574,12 +538,11 @@ clip_face(clip_pivot       *pivot,
                 nf.i[0] = ev0;
                 nf.i[1] = v[1] - verts;
                 nf.i[2] = v[2] - verts;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pl))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->pl;
                 ++ pivot->pr;
                 ++ pivot->r;
@@ -588,12 +551,11 @@ clip_face(clip_pivot       *pivot,
                 nf.i[0] = v[2] - verts;
                 nf.i[1] = ev1;
                 nf.i[2] = ev0;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pl))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->pl;
                 ++ pivot->pr;
                 ++ pivot->r;
@@ -619,23 +581,21 @@ clip_face(clip_pivot       *pivot,
                 nf.i[0] = ev0;
                 nf.i[1] = v[1] - verts;
                 nf.i[2] = v[2] - verts;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pr+1))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->r;
                 
                 nf.i[0] = v[2] - verts;
                 nf.i[1] = ev1;
                 nf.i[2] = ev0;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pr+1))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->r;
             }
             else
@@ -654,23 +614,21 @@ clip_face(clip_pivot       *pivot,
                 nf.i[0] = v[0] - verts; // Right
                 nf.i[1] = ev0;
                 nf.i[2] = ev1;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pr+1))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot->r;
                 
                 nf.i[0] = v[2] - verts; // Left
                 nf.i[1] = ev1;
                 nf.i[2] = ev0;
-                if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+                if (!pools_face_decl_insert(pool, &nf, &in_p,
                                             pivot->pl))
                 {
                     goto L_FailInsertFace;
                 }
-                ++ clips;
                 ++ pivot-> r;
                 ++ pivot->pl;
                 ++ pivot->pr;
@@ -750,12 +708,11 @@ clip_face(clip_pivot       *pivot,
             }
             
             /* Insert face into respective position */
-            if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+            if (!pools_face_decl_insert(pool, &nf, &in_p,
                                         pivot->pl))
             {
                 goto L_FailInsertFace;
             }
-            ++ clips;
             ++ pivot->pl;
             ++ pivot->pr;
             ++ pivot-> r;
@@ -801,12 +758,11 @@ clip_face(clip_pivot       *pivot,
             }
             
             /* Insert face into respective position */
-            if (!pools_face_decl_insert(pool, &nf, pool->planes + face_i,
+            if (!pools_face_decl_insert(pool, &nf, &in_p,
                                         pivot->pr+1))
             {
                 goto L_FailInsertFace;
             }
-            ++ clips;
             ++ pivot->r;
         }
         else
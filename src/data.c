@@ -8,15 +8,53 @@
 *******************************************************************************/
 
 #include "data.h"
+#include "math.h"
+#include "thread.h"
+#include "trace.h"
+#include "verbose.h"
 
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 
+#ifdef OS_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#elif defined(OS_LINUX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define DATA_CHUNK    16384 /* Faces per streamed read */
+#define DATA_PLN_DATA 65536 /* Planes start here: a mapping granule anywhere */
+#define DATA_PLN_VER  1U
 
 typedef enum {
     FST_VERT = 0,
     FST_FACE,
+    FST_PLANE,
 } FILE_SRC_TYPE;
 
+/* .PLN sidecar: the planes of the faces pools_check and pools_make_planes
+ * keep, then the IDs of those they reject, for the VTX / IDX pair whose
+ * sizes and modification times are stamped in the header */
+typedef struct {
+    char     magic[4];      /* "BSPP" */
+    uint32_t version;
+    uint32_t plane_size;    /* sizeof(plane) of the writer */
+    uint32_t reserved;
+    uint64_t stamp[4];      /* VTX size, time, IDX size, time */
+    uint64_t n_faces;       /* In the IDX file */
+    uint64_t n_kept;        /* Planes at DATA_PLN_DATA */
+    uint64_t n_rejects;     /* uint32_t IDs after the planes, ascending */
+} data_pln_header;
+
+static bool data_planes_load(pools *const restrict out, char const *name);
+
 
 #if 0
 static size_t
@@ -35,18 +73,15 @@ fsize(FILE *f)
 }
 #endif
 
+/* Writes name with its extension replaced by the file type's into buf[256] */
 static bool
-fopen_ex(char const *name,
-         FILE **f_out,
-         size_t *sz_out,
+fname_ex(char *buf,
+         char const *name,
          FILE_SRC_TYPE type)
 {
-    char buf[256];
-    FILE *f;
     char *dot = NULL, *pc;
-    size_t sz;
 
-    if (!name || !f_out || !sz_out) return false;
+    if (!buf || !name) return false;
 
     /* Replace extension on name */
     for (pc = buf; *name && pc < (buf+255); ++pc, ++name)
@@ -75,9 +110,31 @@ fopen_ex(char const *name,
             dot[3] = '\0';
             break;
 
+        case FST_PLANE:
+            dot[0] = 'P';
+            dot[1] = 'L';
+            dot[2] = 'N';
+            dot[3] = '\0';
+            break;
+
         default: return false;
         }
     }
+    return true;
+}
+
+static bool
+fopen_ex(char const *name,
+         FILE **f_out,
+         size_t *sz_out,
+         FILE_SRC_TYPE type)
+{
+    char buf[256];
+    FILE *f;
+    size_t sz;
+
+    if (!name || !f_out || !sz_out) return false;
+    if (!fname_ex(buf, name, type)) return false;
     fprintf(stderr, "opening \"%s\".\n", buf);
 
     /* Open file */
@@ -96,9 +153,10 @@ fopen_ex(char const *name,
     return true;
 }
 
-bool
-read_data(pools *const restrict out,
-          char const *name)
+static bool
+read_data_(pools *const restrict out,
+           char const *name,
+           bool *planed)
 {
     FILE *fv = NULL, *ff = NULL;
     size_t fvsz, ffsz, elems;
@@ -147,6 +205,438 @@ read_data(pools *const restrict out,
     }
     fclose(ff); ff = NULL;
 
+    if (planed) *planed = data_planes_load(out, name);
+    return true;
+
+L_Error:
+    if (fv) fclose(fv);
+    if (ff) fclose(ff);
+    return false;
+}
+
+/* Maps a file from byte `at` (a multiple of DATA_PLN_DATA) to its end
+ * copy-on-write: writes land in private pages */
+static void *
+fmap_ex(char const *name,
+        size_t *sz_out,
+        FILE_SRC_TYPE type,
+        size_t at)
+{
+    char buf[256];
+    void *p = NULL;
+    size_t sz = 0U;
+
+    if (!name || !sz_out) return NULL;
+    if (!fname_ex(buf, name, type)) return NULL;
+    fprintf(stderr, "mapping \"%s\".\n", buf);
+
+#ifdef OS_WINDOWS
+    {
+        HANDLE f, m;
+        LARGE_INTEGER li;
+
+        f = CreateFileA(buf, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (f == INVALID_HANDLE_VALUE) return NULL;
+        if (!GetFileSizeEx(f, &li) || (size_t)li.QuadPart <= at)
+        {
+            CloseHandle(f);
+            return NULL;
+        }
+        sz = (size_t)li.QuadPart - at;
+
+        m = CreateFileMappingA(f, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        CloseHandle(f);
+        if (!m) return NULL;
+        p = MapViewOfFile(m, FILE_MAP_COPY, (DWORD)((uint64_t)at >> 32),
+                          (DWORD)at, 0);
+        CloseHandle(m);
+        if (!p) return NULL;
+    }
+#elif defined(OS_LINUX)
+    {
+        struct stat st;
+        int fd = open(buf, O_RDONLY);
+
+        if (fd < 0) return NULL;
+        if (fstat(fd, &st) || (size_t)st.st_size <= at)
+        {
+            close(fd);
+            return NULL;
+        }
+        sz = (size_t)st.st_size - at;
+
+        p = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)at);
+        close(fd);
+        if (p == MAP_FAILED) return NULL;
+
+        /* Faces are scanned in order (pools_check, pools_make_planes);
+         * vertices and planes are gathered by index, so fetch them all up
+         * front */
+        madvise(p, sz, type == FST_FACE ? MADV_SEQUENTIAL : MADV_WILLNEED);
+    }
+#else
+    return NULL;
+#endif
+
+    fprintf(stderr, "File size: %zu.\n", sz);
+
+    *sz_out = sz;
+    return p;
+}
+
+static void
+funmap_ex(void *p, size_t sz)
+{
+    if (!p) return;
+#ifdef OS_WINDOWS
+    (void)sz;
+    UnmapViewOfFile(p);
+#elif defined(OS_LINUX)
+    munmap(p, sz);
+#endif
+}
+
+/* Sizes and modification times of the VTX / IDX pair, to the nanosecond
+ * where the system keeps it */
+static bool
+data_stamp(char const *name, uint64_t *stamp)
+{
+    char buf[256];
+    struct stat st;
+    FILE_SRC_TYPE t;
+
+    for (t = FST_VERT; t <= FST_FACE; ++t)
+    {
+        if (!fname_ex(buf, name, t) || stat(buf, &st)) return false;
+        stamp[2*t+0] = (uint64_t)st.st_size;
+        stamp[2*t+1] = (uint64_t)st.st_mtime;
+#ifdef OS_LINUX
+        /* Seconds alone miss a same size edit within the second */
+        stamp[2*t+1] = stamp[2*t+1] * 1000000000U +
+                       (uint64_t)st.st_mtim.tv_nsec;
+#endif
+    }
+    return true;
+}
+
+/* Maps a current sidecar's planes into pools freshly read from the IDX
+ * file, dropping the faces it rejected. False (pools untouched) when there
+ * is none or it does not match. */
+static bool
+data_planes_load(pools *const restrict out,
+                 char const *name)
+{
+    data_pln_header h;
+    uint64_t stamp[4];
+    uint32_t const *rej;
+    char buf[256];
+    FILE *f;
+    void *p;
+    size_t sz = 0U, i, w, r;
+    bool ok;
+
+    if (!fname_ex(buf, name, FST_PLANE)) return false;
+    f = fopen(buf, "rb");
+    if (!f) return false;
+    ok = fread(&h, sizeof(h), 1, f) == 1;
+    fclose(f);
+
+    if (!ok || memcmp(h.magic, "BSPP", 4) || h.version != DATA_PLN_VER ||
+        h.plane_size != sizeof(plane) || !data_stamp(name, stamp) ||
+        memcmp(h.stamp, stamp, sizeof(stamp)) ||
+        h.n_faces != out->n_faces || h.n_kept + h.n_rejects != h.n_faces)
+    {
+        fprintf(stderr, "Ignoring stale plane file \"%s\".\n", buf);
+        return false;
+    }
+
+    p = fmap_ex(name, &sz, FST_PLANE, DATA_PLN_DATA);
+    if (!p || sz < h.n_kept*sizeof(plane) + h.n_rejects*sizeof(*rej))
+    {
+        fprintf(stderr, "Failed to map plane file \"%s\".\n", buf);
+        funmap_ex(p, sz);
+        return false;
+    }
+
+    /* Rejects must be ascending face IDs before any face moves */
+    rej = (uint32_t const *)((char const *)p + h.n_kept*sizeof(plane));
+    for (r = 0; r < h.n_rejects; ++r)
+    {
+        if (rej[r] >= h.n_faces || (r && rej[r] <= rej[r-1]))
+        {
+            fprintf(stderr, "Plane file \"%s\" is corrupt.\n", buf);
+            funmap_ex(p, sz);
+            return false;
+        }
+    }
+
+    /* Stable compaction from the first reject on */
+    i = w = h.n_rejects ? rej[0] : h.n_faces;
+    for (r = 0; i < h.n_faces; ++i)
+    {
+        if (r < h.n_rejects && rej[r] == i)
+        {
+            ++r;
+            continue;
+        }
+        out->faces[w++] = out->faces[i];
+    }
+
+    fprintf(stderr, "Planes of %zu faces from \"%s\" (%zu rejected).\n",
+            (size_t)h.n_kept, buf, (size_t)h.n_rejects);
+    return pools_map_planes(out, p, sz, (size_t)h.n_kept);
+}
+
+bool
+write_planes(pools const *in,
+             char const *name,
+             pools_rejects const *check,
+             pools_rejects const *planes)
+{
+    static char const zero[DATA_PLN_DATA];
+    data_pln_header h;
+    uint32_t id;
+    char buf[256];
+    FILE *f;
+    size_t i, a = 0U, b = 0U, j = 0U;
+    bool ok;
+
+    if (!in || !in->planes || !check || !planes) return false;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "BSPP", 4);
+    h.version    = DATA_PLN_VER;
+    h.plane_size = sizeof(plane);
+    h.n_kept     = in->n_faces;
+    h.n_rejects  = check->n + planes->n;
+    h.n_faces    = h.n_kept + h.n_rejects;
+    if (!data_stamp(name, h.stamp) || h.n_faces > UINT32_MAX ||
+        !fname_ex(buf, name, FST_PLANE)) return false;
+
+    f = fopen(buf, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open \"%s\" for writing.\n", buf);
+        return false;
+    }
+
+    ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+         fwrite(zero, 1, DATA_PLN_DATA - sizeof(h), f) ==
+                DATA_PLN_DATA - sizeof(h) &&
+         fwrite(in->planes, sizeof(plane), in->n_faces, f) == in->n_faces;
+
+    /* check IDs count every IDX face, planes IDs only those check kept:
+     * walk both back to IDX IDs */
+    for (i = 0; ok && i < h.n_faces; ++i)
+    {
+        if (a < check->n && check->ids[a] == i)
+        {
+            ++a;
+        }
+        else if (b < planes->n && planes->ids[b] == j++)
+        {
+            ++b;
+        }
+        else continue;
+
+        id = (uint32_t)i;
+        ok = fwrite(&id, sizeof(id), 1, f) == 1;
+    }
+
+    if (fclose(f) || !ok)
+    {
+        fprintf(stderr, "Failed to write \"%s\".\n", buf);
+        remove(buf);
+        return false;
+    }
+    fprintf(stderr, "Wrote planes of %zu faces to \"%s\".\n",
+            in->n_faces, buf);
+    return true;
+}
+
+static bool
+read_data_mapped_(pools *const restrict out,
+                  char const *name,
+                  bool *planed)
+{
+    void *v, *f;
+    size_t vsz = 0U, fsz = 0U;
+
+    if (!out) return false;
+
+    v = fmap_ex(name, &vsz, FST_VERT, 0U);
+    if (!v || vsz < sizeof(vert))
+    {
+        fprintf(stderr, "Failed to map vertex file \"%s\".\n", name);
+        funmap_ex(v, vsz);
+        return false;
+    }
+
+    f = fmap_ex(name, &fsz, FST_FACE, 0U);
+    if (!f || fsz < sizeof(face))
+    {
+        fprintf(stderr, "Failed to map index file \"%s\".\n", name);
+        funmap_ex(v, vsz);
+        funmap_ex(f, fsz);
+        return false;
+    }
+
+    if (!pools_alloc_mapped(out, v, vsz, f, fsz))
+    {
+        fprintf(stderr, "Failed to allocate pools.\n");
+        funmap_ex(v, vsz);
+        funmap_ex(f, fsz);
+        return false;
+    }
+
+    if (planed) *planed = data_planes_load(out, name);
+    return true;
+}
+
+
+typedef struct {
+    FILE        *f;
+    face        *faces;
+    size_t       n;
+    thread_gate *gate;
+} data_stream;
+
+/* Reader: posts the number of faces read after every chunk */
+static void
+data_stream_read(void *arg)
+{
+    data_stream *st = arg;
+    size_t done = 0U, got;
+
+    trace_begin("data_stream_read");
+    while (done < st->n)
+    {
+        size_t want = st->n - done;
+        if (want > DATA_CHUNK) want = DATA_CHUNK;
+
+        got = fread(st->faces + done, sizeof(face), want, st->f);
+        done += got;
+        thread_gate_post(st->gate, done);
+        if (got != want) break;
+    }
+    trace_end();
+    thread_gate_close(st->gate);
+}
+
+static bool
+read_data_stream_(pools *const restrict out,
+                  char const *name)
+{
+    FILE *fv = NULL, *ff = NULL;
+    size_t fvsz, ffsz, nv, r = 0U, w = 0U, avail, n_bad = 0U, n_flat = 0U;
+    data_stream st;
+    thread *reader;
+
+    if (!out) return false;
+
+    if (!fopen_ex(name, &fv, &fvsz, FST_VERT))
+    {
+        fprintf(stderr, "Failed to open vertex file \"%s\".\n", name);
+        return false;
+    }
+    if (!fopen_ex(name, &ff, &ffsz, FST_FACE))
+    {
+        fprintf(stderr, "Failed to open index file \"%s\".\n", name);
+        fclose(fv);
+        return false;
+    }
+
+    /* Nothing is cleared: every face and plane kept is written below */
+    if (!pools_alloc_raw(out, fvsz / sizeof(vert), ffsz / sizeof(face)))
+    {
+        fprintf(stderr, "Failed to allocate pools.\n");
+        goto L_Error;
+    }
+
+    nv = out->n_verts;
+    if (nv != fread(out->verts, sizeof(vert), nv, fv))
+    {
+        fprintf(stderr, "Vertex read failure.\n");
+        goto L_Error;
+    }
+    fclose(fv); fv = NULL;
+
+    st.f     = ff;
+    st.faces = out->faces;
+    st.n     = out->n_faces;
+    st.gate  = thread_gate_new();
+    if (!st.gate)
+    {
+        fprintf(stderr, "Failed to allocate stream.\n");
+        goto L_Error;
+    }
+
+    /* Read ahead on another thread (or up front if none can start) */
+    reader = thread_start(data_stream_read, &st);
+    if (!reader) data_stream_read(&st);
+
+    fprintf(stderr, "Num verts: %zu.\nNum faces: %zu.\n", nv, st.n);
+
+    /* Validate and make planes behind the reader, compacting in place:
+     * the write position never passes the read position */
+    while (r < st.n)
+    {
+        avail = thread_gate_wait(st.gate, r + DATA_CHUNK < st.n ?
+                                          r + DATA_CHUNK : st.n);
+        if (avail <= r) break;
+
+        for (; r < avail; ++r)
+        {
+            face *f = out->faces + r;
+
+            if (f->i[0] >= nv || f->i[1] >= nv || f->i[2] >= nv)
+            {
+                VERBOSE_3
+                (
+                    fprintf(stderr,
+                            "Face %zu contains an index that exceeds the "
+                            "vertex pool and will be deleted.\n", r);
+                )
+                ++n_bad;
+                continue;
+            }
+            if (!plane_from_face(out->planes + w, out->verts, f))
+            {
+                VERBOSE_3
+                (
+                    fprintf(stderr,
+                            "Face %zu does not form a plane and will be "
+                            "deleted.\n", r);
+                )
+                ++n_flat;
+                continue;
+            }
+            out->faces[w++] = *f;
+        }
+    }
+
+    thread_join(reader);
+    thread_gate_free(st.gate);
+
+    if (r < st.n)
+    {
+        fprintf(stderr, "Index read failure.\n");
+        goto L_Error;
+    }
+    fclose(ff); ff = NULL;
+
+    if (n_bad)
+    {
+        fprintf(stderr, "%zu faces contain an index that exceeds the vertex "
+                        "pool and were deleted.\n", n_bad);
+    }
+    if (n_flat)
+    {
+        fprintf(stderr, "%zu faces do not form a plane and were deleted.\n",
+                n_flat);
+    }
+    out->n_faces = w;
     return true;
 
 L_Error:
@@ -155,3 +645,35 @@ L_Error:
     return false;
 }
 
+bool
+read_data(pools *const restrict out, char const *name, bool *planed)
+{
+    bool ok;
+
+    trace_begin("read_data");
+    ok = read_data_(out, name, planed);
+    trace_end();
+    return ok;
+}
+
+bool
+read_data_mapped(pools *const restrict out, char const *name, bool *planed)
+{
+    bool ok;
+
+    trace_begin("read_data_mapped");
+    ok = read_data_mapped_(out, name, planed);
+    trace_end();
+    return ok;
+}
+
+bool
+read_data_stream(pools *const restrict out, char const *name)
+{
+    bool ok;
+
+    trace_begin("read_data_stream");
+    ok = read_data_stream_(out, name);
+    trace_end();
+    return ok;
+}
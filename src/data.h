@@ -12,6 +12,23 @@
 
 #include "pools.h"
 
-bool read_data(pools *const restrict out, char const *name);
+/* When planed is given and a current .PLN sidecar exists, its planes are
+ * mapped in and its rejects dropped: *planed is then true and no
+ * pools_check or pools_make_planes is needed */
+bool read_data(pools *const restrict out, char const *name, bool *planed);
+
+/* As read_data, but maps the files copy-on-write instead of reading them */
+bool read_data_mapped(pools *const restrict out, char const *name,
+                      bool *planed);
+
+/* Reads, validates and makes planes in one pass: faces are checked as
+ * chunks arrive from a reader thread, so no pools_check or
+ * pools_make_planes is needed afterwards */
+bool read_data_stream(pools *const restrict out, char const *name);
+
+/* Writes the .PLN sidecar of checked and planed pools read from name,
+ * given the rejects of pools_check and pools_make_planes */
+bool write_planes(pools const *in, char const *name,
+                  pools_rejects const *check, pools_rejects const *planes);
 
 #endif /* DATA_H */
@@ -395,6 +395,8 @@ draw_rel(void)
 
 
 
+static plane draw_frustum[6];
+
 static void
 draw_part(bsp_ind ind, bool t)
 {
@@ -418,6 +420,11 @@ draw_part(bsp_ind ind, bool t)
     
     pt = bsp_node_from_id(&g_bsp, ind);
     if (!pt) return;
+
+    /* Skip subtrees out of view */
+    for (i = 0; i < 6; ++i)
+        if (bsp_box_outside(g_bsp.box + ind, draw_frustum + i))
+            return;
     
     if (t)
     {
@@ -433,7 +440,7 @@ draw_part(bsp_ind ind, bool t)
         
         /* Determine which side of the plane the camera is on */
         d = vec3_project_plane_get_d(planes + pt->pl, projected, g_ray);
-        if (d <= -FLT_EPSILON)
+        if (d <= -PLANE_EPSILON)
         {
             glBegin(GL_LINES);
                 glColor3f(1.0f, 0.0f, 0.0f);
@@ -444,7 +451,7 @@ draw_part(bsp_ind ind, bool t)
             draw_part(pt->l, true);
             draw_part(pt->r, false);
         }
-        else if (d >= FLT_EPSILON)
+        else if (d >= PLANE_EPSILON)
         {
             glBegin(GL_LINES);
                 glColor3f(0.0f, 1.0f, 0.0f);
@@ -506,6 +513,7 @@ draw_bsp(void)
     glEnd();
 
     /* Traverse the BSP */
+    camera_get_frustum(draw_frustum);
     draw_part(0, true);
 
 #ifdef OS_WINDOWS
@@ -0,0 +1,1163 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Geometry importers for interchange formats (Wavefront OBJ, Stanford PLY).
+    Files are parsed in parallel chunks straight into the pools: a first pass
+    counts what each chunk holds, a second writes it at its final offset.
+*******************************************************************************/
+
+#include "import.h"
+#include "math.h"
+#include "thread.h"
+#include "verbose.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMPORT_POLY_MAX 256 /* Corners kept per polygon */
+#define PLY_ELEM_MAX    8
+#define PLY_PROP_MAX    16
+
+
+
+typedef struct {
+    char const *s, *e;   /* Text (or records) of this chunk */
+    size_t first, n;     /* First record, number of records */
+    size_t nv, nf;       /* Vertices and triangles it holds (pass 1) */
+    size_t ov, of;       /* Where they go in the pools (pass 2) */
+} import_chunk;
+
+
+
+/* -------------------------------------------------------------------------- */
+/*  Text scanning                                                             */
+/* -------------------------------------------------------------------------- */
+
+static inline char const *
+import_skip_ws(char const *p, char const *e)
+{
+    while (p < e && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+static inline char const *
+import_line_end(char const *p, char const *e)
+{
+    char const *n = memchr(p, '\n', (size_t)(e - p));
+    return n ? n : e;
+}
+
+/* Decimal number with optional sign, fraction and exponent. Accumulates in
+ * double, which is well within float precision for geometry. */
+static char const *
+import_number(char const *p, char const *e, double *out)
+{
+    static double const p10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    double v = 0.0;
+    bool neg = false, digits = false;
+    int ex = 0;
+
+    p = import_skip_ws(p, e);
+    if (p < e && (*p == '-' || *p == '+')) neg = *p++ == '-';
+
+    for (; p < e && (unsigned)(*p - '0') < 10U; ++p, digits = true)
+        v = v*10.0 + (*p - '0');
+    if (p < e && *p == '.')
+    {
+        for (++p; p < e && (unsigned)(*p - '0') < 10U; ++p, digits = true)
+        {
+            v = v*10.0 + (*p - '0');
+            --ex;
+        }
+    }
+    if (!digits) return NULL;
+
+    if (p < e && (*p == 'e' || *p == 'E'))
+    {
+        char const *q = p + 1;
+        bool eneg = false;
+        int x = 0;
+
+        if (q < e && (*q == '-' || *q == '+')) eneg = *q++ == '-';
+        if (q < e && (unsigned)(*q - '0') < 10U)
+        {
+            for (; q < e && (unsigned)(*q - '0') < 10U; ++q)
+                if (x < 1000) x = x*10 + (*q - '0');
+            ex += eneg ? -x : x;
+            p = q;
+        }
+    }
+
+    while (ex < -22) { v /= 1e22; ex += 22; }
+    while (ex >  22) { v *= 1e22; ex -= 22; }
+    v = ex < 0 ? v / p10[-ex] : v * p10[ex];
+
+    *out = neg ? -v : v;
+    return p;
+}
+
+static char const *
+import_integer(char const *p, char const *e, long *out)
+{
+    long v = 0;
+    bool neg = false;
+
+    p = import_skip_ws(p, e);
+    if (p < e && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    if (p >= e || (unsigned)(*p - '0') >= 10U) return NULL;
+    for (; p < e && (unsigned)(*p - '0') < 10U; ++p)
+        if (v < 0x7FFFFFFFL) v = v*10 + (*p - '0');
+
+    *out = neg ? -v : v;
+    return p;
+}
+
+
+
+/* Splits [s, e) into n pieces starting on line boundaries */
+static void
+import_split_lines(import_chunk *c, size_t n, char const *s, char const *e)
+{
+    size_t const len = (size_t)(e - s);
+    size_t i;
+
+    for (i = 0; i < n; ++i)
+    {
+        char const *b = i ? c[i-1].e : s;
+        char const *x = s + len / n * (i + 1);
+
+        if (i == n - 1 || x <= b) x = i == n - 1 ? e : b;
+        else                      x = import_line_end(x, e) + (x < e);
+        if (x > e) x = e;
+
+        memset(c + i, 0, sizeof(import_chunk));
+        c[i].s = b;
+        c[i].e = x;
+    }
+}
+
+/* Prefix sums of the chunk counts into write offsets */
+static void
+import_offsets(import_chunk *c, size_t n, size_t *nv, size_t *nf)
+{
+    size_t i, v = 0U, f = 0U;
+
+    for (i = 0; i < n; ++i)
+    {
+        c[i].ov = v;  v += c[i].nv;
+        c[i].of = f;  f += c[i].nf;
+    }
+    *nv = v;
+    *nf = f;
+}
+
+static unsigned
+import_chunks(unsigned threads)
+{
+    if (!threads) threads = thread_count();
+    return threads ? threads : 1U;
+}
+
+/* Whole file into memory, terminated */
+static char *
+import_load(char const *path, size_t *sz_out)
+{
+    FILE *f = fopen(path, "rb");
+    char *buf;
+    long sz;
+
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) || (sz = ftell(f)) < 0)
+    {
+        fclose(f);
+        return NULL;
+    }
+    rewind(f);
+
+    buf = malloc((size_t)sz + 1U);
+    if (buf && fread(buf, 1, (size_t)sz, f) != (size_t)sz)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (!buf) return NULL;
+
+    buf[sz]  = '\0';
+    *sz_out  = (size_t)sz;
+    return buf;
+}
+
+/* Vertex index, or 0xFFFF (always out of range) if it cannot be stored */
+static inline unsigned short
+import_index(long i)
+{
+    return (i < 0 || i >= 0xFFFF) ? 0xFFFF : (unsigned short)i;
+}
+
+/* Fans a polygon into triangles */
+static size_t
+import_fan(face *out, unsigned short const *idx, size_t n)
+{
+    size_t k;
+
+    for (k = 2; k < n; ++k)
+    {
+        out[k-2].i[0] = idx[0];
+        out[k-2].i[1] = idx[k-1];
+        out[k-2].i[2] = idx[k];
+    }
+    return n < 3 ? 0U : n - 2;
+}
+
+
+
+/* -------------------------------------------------------------------------- */
+/*  Wavefront OBJ                                                             */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    pools        *out;
+    import_chunk *c;
+    bool          write; /* Pass 2 */
+} import_obj_job;
+
+static void
+import_obj_chunk(void *arg, size_t begin, size_t end)
+{
+    import_obj_job const *j = arg;
+
+    for (; begin < end; ++begin)
+    {
+        import_chunk *c = j->c + begin;
+        char const *p = c->s, *e = c->e;
+        size_t nv = 0U, nf = 0U;
+
+        while (p < e)
+        {
+            char const *le = import_line_end(p, e);
+
+            p = import_skip_ws(p, le);
+            if (le - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                if (j->write)
+                {
+                    float *v = j->out->verts[c->ov + nv].m;
+                    double x[3] = { 0.0, 0.0, 0.0 };
+                    char const *q = p + 1;
+                    unsigned char k;
+
+                    for (k = 0; k < 3 && q; ++k)
+                        q = import_number(q, le, x + k);
+                    v[0] = (float)x[0];
+                    v[1] = (float)x[1];
+                    v[2] = (float)x[2];
+                }
+                ++nv;
+            }
+            else if (le - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                unsigned short idx[IMPORT_POLY_MAX];
+                size_t n = 0U;
+                char const *q = p + 1;
+
+                /* Corners are v, v/vt, v//vn or v/vt/vn: keep v */
+                for (;;)
+                {
+                    long i = 0;
+
+                    q = import_skip_ws(q, le);
+                    if (q >= le) break;
+                    if (j->write)
+                    {
+                        char const *r = import_integer(q, le, &i);
+                        if      (!r)    i = 0xFFFF;
+                        else if (i > 0) i -= 1;
+                        else if (i < 0) i += (long)(c->ov + nv); /* Relative */
+                        else            i = 0xFFFF;
+                        if (n < IMPORT_POLY_MAX) idx[n] = import_index(i);
+                    }
+                    ++n;
+                    while (q < le && *q != ' ' && *q != '\t') ++q;
+                }
+                if (n > IMPORT_POLY_MAX) n = IMPORT_POLY_MAX;
+
+                if (j->write)
+                    import_fan(j->out->faces + c->of + nf, idx, n);
+                nf += n < 3 ? 0U : n - 2;
+            }
+            p = le + 1;
+        }
+
+        c->nv = nv;
+        c->nf = nf;
+    }
+}
+
+bool
+import_obj(pools *out, char const *path, unsigned threads)
+{
+    import_chunk *c;
+    import_obj_job j;
+    char *buf;
+    size_t sz, n, nv, nf;
+
+    if (!out || !path) return false;
+
+    buf = import_load(path, &sz);
+    if (!buf)
+    {
+        fprintf(stderr, "Failed to read \"%s\".\n", path);
+        return false;
+    }
+
+    n = import_chunks(threads);
+    c = malloc(n * sizeof(import_chunk));
+    if (!c)
+    {
+        free(buf);
+        return false;
+    }
+    import_split_lines(c, n, buf, buf + sz);
+
+    /* Count, place, then parse into place */
+    j.out   = out;
+    j.c     = c;
+    j.write = false;
+    thread_for(import_obj_chunk, &j, n, (unsigned)n);
+    import_offsets(c, n, &nv, &nf);
+
+    if (nv > 0xFFFF)
+    {
+        fprintf(stderr, "\"%s\" has %zu vertices, over the 16-bit index "
+                        "limit.\n", path, nv);
+    }
+    else if (!nv || !nf)
+    {
+        fprintf(stderr, "\"%s\" has no geometry.\n", path);
+    }
+    else if (!pools_alloc_raw(out, nv, nf))
+    {
+        fprintf(stderr, "Failed to allocate pools.\n");
+    }
+    else
+    {
+        j.write = true;
+        thread_for(import_obj_chunk, &j, n, (unsigned)n);
+        free(c);
+        free(buf);
+        return true;
+    }
+
+    free(c);
+    free(buf);
+    return false;
+}
+
+
+
+/* -------------------------------------------------------------------------- */
+/*  Stanford PLY                                                              */
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+    PLY_ASCII = 0,
+    PLY_LE,
+    PLY_BE,
+} PLY_FORMAT;
+
+typedef enum {
+    PLY_CHAR = 0, PLY_UCHAR, PLY_SHORT, PLY_USHORT,
+    PLY_INT,      PLY_UINT,  PLY_FLOAT, PLY_DOUBLE,
+    PLY_BAD,
+} PLY_TYPE;
+
+typedef enum {
+    PLY_ROLE_NONE = 0,
+    PLY_ROLE_X, PLY_ROLE_Y, PLY_ROLE_Z,   /* Vertex */
+    PLY_ROLE_INDICES,                     /* Face   */
+    PLY_ROLE_NX, PLY_ROLE_NY, PLY_ROLE_NZ, PLY_ROLE_D,
+} PLY_ROLE;
+
+typedef struct {
+    PLY_TYPE type, count; /* count != PLY_BAD for lists */
+    PLY_ROLE role;
+} ply_prop;
+
+typedef struct {
+    char     name[64];
+    size_t   n, stride;   /* stride = 0 if records vary in size */
+    ply_prop p[PLY_PROP_MAX];
+    unsigned np;
+    char const *s, *e;    /* Records in the body */
+} ply_elem;
+
+typedef struct {
+    PLY_FORMAT fmt;
+    ply_elem   el[PLY_ELEM_MAX];
+    unsigned   ne;
+    ply_elem  *vert, *face;
+    bool       planes;    /* Faces carry nx ny nz d */
+} ply_file;
+
+typedef struct {
+    char const *p, *e;
+    PLY_FORMAT  fmt;
+    bool        ok;
+} ply_cursor;
+
+
+
+static PLY_TYPE
+ply_type(char const *s)
+{
+    static struct { char const *name; PLY_TYPE t; } const names[] =
+    {
+        { "char",  PLY_CHAR  }, { "int8",    PLY_CHAR   },
+        { "uchar", PLY_UCHAR }, { "uint8",   PLY_UCHAR  },
+        { "short", PLY_SHORT }, { "int16",   PLY_SHORT  },
+        { "ushort",PLY_USHORT}, { "uint16",  PLY_USHORT },
+        { "int",   PLY_INT   }, { "int32",   PLY_INT    },
+        { "uint",  PLY_UINT  }, { "uint32",  PLY_UINT   },
+        { "float", PLY_FLOAT }, { "float32", PLY_FLOAT  },
+        { "double",PLY_DOUBLE}, { "float64", PLY_DOUBLE },
+    };
+    unsigned i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        if (!strcmp(s, names[i].name)) return names[i].t;
+    return PLY_BAD;
+}
+
+static size_t
+ply_size(PLY_TYPE t)
+{
+    static unsigned char const sz[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+    return sz[t];
+}
+
+static double
+ply_get(ply_cursor *c, PLY_TYPE t)
+{
+    unsigned char b[8];
+    size_t n, k;
+    double v = 0.0;
+    bool big;
+
+    if (!c->ok) return 0.0;
+
+    if (c->fmt == PLY_ASCII)
+    {
+        char const *q;
+
+        /* Records are whitespace separated; newlines count too */
+        while (c->p < c->e && isspace((unsigned char)*c->p)) ++c->p;
+        q = import_number(c->p, c->e, &v);
+        if (!q) { c->ok = false; return 0.0; }
+        c->p = q;
+        return v;
+    }
+
+    n = ply_size(t);
+    if ((size_t)(c->e - c->p) < n) { c->ok = false; return 0.0; }
+
+    /* Assemble in host order */
+    {
+        unsigned short const one = 1;
+        big = !*(unsigned char const *)&one;
+    }
+    for (k = 0; k < n; ++k)
+        b[k] = (unsigned char)c->p[(c->fmt == PLY_BE) == big ? k : n-1-k];
+    c->p += n;
+
+    switch (t)
+    {
+    case PLY_CHAR:   return (double)(signed char)b[0];
+    case PLY_UCHAR:  return (double)b[0];
+    case PLY_SHORT:  { short          x; memcpy(&x, b, 2); return x; }
+    case PLY_USHORT: { unsigned short x; memcpy(&x, b, 2); return x; }
+    case PLY_INT:    { int            x; memcpy(&x, b, 4); return x; }
+    case PLY_UINT:   { unsigned int   x; memcpy(&x, b, 4); return x; }
+    case PLY_FLOAT:  { float          x; memcpy(&x, b, 4); return x; }
+    case PLY_DOUBLE: { double         x; memcpy(&x, b, 8); return x; }
+    default:         c->ok = false; return 0.0;
+    }
+}
+
+/* Reads one record. Vertex positions go to xyz, face corners to idx[*n]
+ * (n counts all corners, even past the buffer) and face planes to pl. */
+static void
+ply_record(ply_cursor *c, ply_elem const *el,
+           float *xyz, unsigned short *idx, size_t *n, plane *pl)
+{
+    unsigned i;
+
+    for (i = 0; i < el->np && c->ok; ++i)
+    {
+        ply_prop const *pp = el->p + i;
+        double v;
+
+        if (pp->count != PLY_BAD)
+        {
+            double const cnt = ply_get(c, pp->count);
+            size_t k, m = cnt > 0.0 ? (size_t)cnt : 0U;
+
+            for (k = 0; k < m && c->ok; ++k)
+            {
+                v = ply_get(c, pp->type);
+                if (pp->role == PLY_ROLE_INDICES && idx && k < IMPORT_POLY_MAX)
+                    idx[k] = v >= 0.0 && v < 0xFFFF ? (unsigned short)v
+                                                    : 0xFFFF;
+            }
+            if (pp->role == PLY_ROLE_INDICES && n) *n = m;
+            continue;
+        }
+
+        v = ply_get(c, pp->type);
+        switch (pp->role)
+        {
+        case PLY_ROLE_X:  if (xyz) xyz[0] = (float)v;  break;
+        case PLY_ROLE_Y:  if (xyz) xyz[1] = (float)v;  break;
+        case PLY_ROLE_Z:  if (xyz) xyz[2] = (float)v;  break;
+        case PLY_ROLE_NX: if (pl)  pl->m[0] = (float)v; break;
+        case PLY_ROLE_NY: if (pl)  pl->m[1] = (float)v; break;
+        case PLY_ROLE_NZ: if (pl)  pl->m[2] = (float)v; break;
+        case PLY_ROLE_D:  if (pl)  pl->d    = (float)v; break;
+        default: break;
+        }
+    }
+
+    /* ASCII records end with their line */
+    if (c->fmt == PLY_ASCII)
+        c->p = import_line_end(c->p, c->e) + (c->p < c->e);
+}
+
+
+
+static bool
+ply_header(ply_file *pf, char const *buf, size_t sz, char const **body)
+{
+    char const *p = buf, *e = buf + sz;
+    ply_elem *el = NULL;
+    char line[256], a[64], b[64], c[64], d[64];
+
+    memset(pf, 0, sizeof(ply_file));
+
+    if (sz < 4 || memcmp(buf, "ply", 3)) return false;
+
+    while (p < e)
+    {
+        char const *le = import_line_end(p, e);
+        size_t len = (size_t)(le - p);
+        int k;
+
+        if (len >= sizeof(line)) len = sizeof(line) - 1;
+        memcpy(line, p, len);
+        line[len] = '\0';
+        p = le + 1;
+
+        a[0] = b[0] = c[0] = d[0] = '\0';
+        k = sscanf(line, "%63s %63s %63s %63s", a, b, c, d);
+        if (k <= 0) continue;
+
+        if (!strcmp(a, "end_header"))
+        {
+            *body = p > e ? e : p;
+            return true;
+        }
+        else if (!strcmp(a, "format") && k >= 2)
+        {
+            if      (!strcmp(b, "ascii"))                pf->fmt = PLY_ASCII;
+            else if (!strcmp(b, "binary_little_endian")) pf->fmt = PLY_LE;
+            else if (!strcmp(b, "binary_big_endian"))    pf->fmt = PLY_BE;
+            else return false;
+        }
+        else if (!strcmp(a, "element") && k >= 3)
+        {
+            if (pf->ne >= PLY_ELEM_MAX) return false;
+            el = pf->el + pf->ne++;
+            strcpy(el->name, b);
+            el->n = (size_t)strtoull(c, NULL, 10);
+            el->stride = 0U;
+            if      (!strcmp(b, "vertex")) pf->vert = el;
+            else if (!strcmp(b, "face"))   pf->face = el;
+        }
+        else if (!strcmp(a, "property") && el && k >= 3)
+        {
+            ply_prop *pp;
+            char const *name;
+
+            if (el->np >= PLY_PROP_MAX) return false;
+            pp = el->p + el->np++;
+            if (!strcmp(b, "list") && k >= 4)
+            {
+                /* property list <count type> <item type> <name> */
+                char nm[64] = "";
+                sscanf(line, "%*s %*s %*s %*s %63s", nm);
+                pp->count = ply_type(c);
+                pp->type  = ply_type(d);
+                if (pp->count == PLY_BAD || pp->type == PLY_BAD) return false;
+                pp->role = (el == pf->face && (!strcmp(nm, "vertex_indices") ||
+                                               !strcmp(nm, "vertex_index")))
+                         ? PLY_ROLE_INDICES : PLY_ROLE_NONE;
+                continue;
+            }
+
+            pp->count = PLY_BAD;
+            pp->type  = ply_type(b);
+            if (pp->type == PLY_BAD) return false;
+            name = c;
+            pp->role = PLY_ROLE_NONE;
+            if (el == pf->vert)
+            {
+                if      (!strcmp(name, "x")) pp->role = PLY_ROLE_X;
+                else if (!strcmp(name, "y")) pp->role = PLY_ROLE_Y;
+                else if (!strcmp(name, "z")) pp->role = PLY_ROLE_Z;
+            }
+            else if (el == pf->face)
+            {
+                if      (!strcmp(name, "nx")) pp->role = PLY_ROLE_NX;
+                else if (!strcmp(name, "ny")) pp->role = PLY_ROLE_NY;
+                else if (!strcmp(name, "nz")) pp->role = PLY_ROLE_NZ;
+                else if (!strcmp(name, "d"))  pp->role = PLY_ROLE_D;
+            }
+        }
+    }
+    return false;
+}
+
+/* Steps over one binary record, reading only its list counts */
+static void
+ply_skip(ply_cursor *c, ply_elem const *el)
+{
+    unsigned i;
+
+    for (i = 0; i < el->np && c->ok; ++i)
+    {
+        ply_prop const *pp = el->p + i;
+        size_t const sz = ply_size(pp->type);
+        size_t m = 1U;
+
+        if (pp->count != PLY_BAD)
+        {
+            double const cnt = ply_get(c, pp->count);
+            m = cnt > 0.0 ? (size_t)cnt : 0U;
+        }
+        if (!c->ok || (size_t)(c->e - c->p) / sz < m) c->ok = false;
+        else                                          c->p += m * sz;
+    }
+}
+
+/* Counts the lines starting in each chunk */
+static void
+ply_count_lines(void *arg, size_t begin, size_t end)
+{
+    import_chunk *c = arg;
+
+    for (; begin < end; ++begin)
+    {
+        char const *p = c[begin].s, *e = c[begin].e;
+        size_t n = 0U;
+
+        for (; p < e; ++n) p = import_line_end(p, e) + 1;
+        c[begin].n = n;
+    }
+}
+
+typedef struct {
+    import_chunk  *c;
+    size_t const  *line; /* Line numbers to find, ascending */
+    char const   **at;   /* Where those lines start */
+    unsigned       n;
+} ply_mark_job;
+
+/* Each chunk finds the lines it holds */
+static void
+ply_mark_lines(void *arg, size_t begin, size_t end)
+{
+    ply_mark_job const *j = arg;
+
+    for (; begin < end; ++begin)
+    {
+        import_chunk const *c = j->c + begin;
+        char const *p = c->s;
+        size_t r = c->first;
+        unsigned k;
+
+        for (k = 0; k < j->n; ++k)
+        {
+            if (j->line[k] < c->first || j->line[k] >= c->first + c->n)
+                continue;
+            for (; r < j->line[k]; ++r) p = import_line_end(p, c->e) + 1;
+            j->at[k] = p;
+        }
+    }
+}
+
+typedef struct {
+    ply_file const *pf;
+    ply_elem const *el;
+    import_chunk   *c;
+} ply_stride_job;
+
+/* Checks that every record of each chunk is el->stride bytes long. Record
+ * r is read from s + r*stride, so a whole element that passes is proven
+ * to lie there. A chunk that fails is left with e = NULL. */
+static void
+ply_check_stride(void *arg, size_t begin, size_t end)
+{
+    ply_stride_job const *j = arg;
+    size_t const stride = j->el->stride;
+
+    for (; begin < end; ++begin)
+    {
+        import_chunk *c = j->c + begin;
+        char const *p = j->el->s + c->first * stride;
+        ply_cursor cur;
+        size_t r;
+
+        cur.e = j->el->e; cur.fmt = j->pf->fmt; cur.ok = true;
+        for (r = 0; r < c->n && cur.ok; ++r, p += stride)
+        {
+            cur.p = p;
+            ply_skip(&cur, j->el);
+            if (cur.p != p + stride) cur.ok = false;
+        }
+        c->e = cur.ok ? p : NULL;
+    }
+}
+
+/* Splits count records into n chunks, by number */
+static void
+ply_split_records(import_chunk *c, size_t n, size_t count)
+{
+    size_t i, r = 0U;
+
+    for (i = 0; i < n; ++i)
+    {
+        size_t const end = count / n * (i + 1) + (i == n - 1 ? count % n : 0U);
+
+        memset(c + i, 0, sizeof(import_chunk));
+        c[i].first = r;
+        c[i].n     = end - r;
+        r = end;
+    }
+}
+
+/* Finds where the ASCII elements lie: lines are counted per chunk, then
+ * each chunk picks out the element starts that fall in it */
+static bool
+ply_locate_lines(ply_file *pf, char const *body, char const *e,
+                 import_chunk *c, size_t n)
+{
+    size_t line[PLY_ELEM_MAX + 1], total = 0U, i;
+    char const *at[PLY_ELEM_MAX + 1];
+    ply_mark_job j;
+
+    import_split_lines(c, n, body, e);
+    thread_for(ply_count_lines, c, n, (unsigned)n);
+    for (i = 0; i < n; ++i)
+    {
+        c[i].first = total;
+        total += c[i].n;
+    }
+
+    line[0] = 0U;
+    for (i = 0; i < pf->ne; ++i)
+    {
+        if (pf->el[i].n > total - line[i]) return false;
+        line[i+1] = line[i] + pf->el[i].n;
+    }
+    for (i = 0; i <= pf->ne; ++i) at[i] = e;
+
+    j.c    = c;
+    j.line = line;
+    j.at   = at;
+    j.n    = pf->ne + 1U;
+    thread_for(ply_mark_lines, &j, n, (unsigned)n);
+
+    for (i = 0; i < pf->ne; ++i)
+    {
+        pf->el[i].stride = 0U;
+        pf->el[i].s      = at[i];
+        pf->el[i].e      = at[i+1];
+    }
+    return true;
+}
+
+/* Finds where each element's records lie. Fixed size binary records are
+ * located by arithmetic. Records with lists usually all have one size too
+ * (faces of one polygon type): the first record's size is checked against
+ * every record in parallel, and only if that fails are they walked. */
+static bool
+ply_locate(ply_file *pf, char const *body, char const *e,
+           import_chunk *c, size_t n)
+{
+    char const *p = body;
+    unsigned i, k;
+
+    if (pf->fmt == PLY_ASCII) return ply_locate_lines(pf, body, e, c, n);
+
+    for (i = 0; i < pf->ne; ++i)
+    {
+        ply_elem *el = pf->el + i;
+        size_t stride = 0U, r;
+        bool fixed = true;
+
+        for (k = 0; k < el->np; ++k)
+        {
+            if (el->p[k].count != PLY_BAD) fixed = false;
+            stride += ply_size(el->p[k].type);
+        }
+        el->s = p;
+
+        if (!fixed && el->n)
+        {
+            ply_stride_job j;
+            ply_cursor cur;
+
+            cur.p = p; cur.e = e; cur.fmt = pf->fmt; cur.ok = true;
+            ply_skip(&cur, el);
+            if (!cur.ok) return false;
+            stride = (size_t)(cur.p - p);
+
+            if ((size_t)(e - p) / stride >= el->n)
+            {
+                el->stride = stride;
+                el->e      = p + stride * el->n;
+                ply_split_records(c, n, el->n);
+                j.pf = pf;
+                j.el = el;
+                j.c  = c;
+                thread_for(ply_check_stride, &j, n, (unsigned)n);
+                fixed = true;
+                for (k = 0; k < n; ++k)
+                    if (!c[k].e) fixed = false;
+            }
+        }
+
+        if (fixed && stride)
+        {
+            if ((size_t)(e - p) / stride < el->n) return false;
+            el->stride = stride;
+            p += stride * el->n;
+        }
+        else
+        {
+            ply_cursor cur;
+
+            cur.p = p; cur.e = e; cur.fmt = pf->fmt; cur.ok = true;
+            for (r = 0; r < el->n && cur.ok; ++r) ply_skip(&cur, el);
+            if (!cur.ok) return false;
+            el->stride = 0U;
+            p = cur.p;
+        }
+        el->e = p;
+    }
+    return true;
+}
+
+/* Splits an element into n chunks of records */
+static void
+ply_split(import_chunk *c, size_t n, ply_file const *pf, ply_elem const *el)
+{
+    ply_cursor cur;
+    size_t i, r = 0U;
+
+    /* Line aligned pieces, numbered by their line counts */
+    if (pf->fmt == PLY_ASCII)
+    {
+        import_split_lines(c, n, el->s, el->e);
+        thread_for(ply_count_lines, c, n, (unsigned)n);
+        for (i = 0; i < n; ++i)
+        {
+            if (c[i].n > el->n - r) c[i].n = el->n - r;
+            c[i].first = r;
+            r += c[i].n;
+        }
+        return;
+    }
+
+    ply_split_records(c, n, el->n);
+    cur.p = el->s; cur.e = el->e; cur.fmt = pf->fmt; cur.ok = true;
+
+    for (i = 0; i < n; ++i)
+    {
+        if (el->stride)
+        {
+            c[i].s = el->s +  c[i].first          * el->stride;
+            c[i].e = el->s + (c[i].first + c[i].n) * el->stride;
+            continue;
+        }
+        c[i].s = cur.p;
+        for (r = 0; r < c[i].n; ++r) ply_skip(&cur, el);
+        c[i].e = cur.p;
+    }
+}
+
+typedef struct {
+    pools          *out;
+    ply_file const *pf;
+    import_chunk   *c;
+    bool            write;
+} import_ply_job;
+
+static void
+import_ply_verts(void *arg, size_t begin, size_t end)
+{
+    import_ply_job const *j = arg;
+
+    for (; begin < end; ++begin)
+    {
+        import_chunk const *c = j->c + begin;
+        ply_cursor cur;
+        size_t r;
+
+        cur.p = c->s; cur.e = c->e; cur.fmt = j->pf->fmt; cur.ok = true;
+        for (r = 0; r < c->n; ++r)
+        {
+            float *v = j->out->verts[c->first + r].m;
+            v[0] = v[1] = v[2] = 0.0f;
+            ply_record(&cur, j->pf->vert, v, NULL, NULL, NULL);
+        }
+    }
+}
+
+static void
+import_ply_faces(void *arg, size_t begin, size_t end)
+{
+    import_ply_job const *j = arg;
+
+    for (; begin < end; ++begin)
+    {
+        import_chunk *c = j->c + begin;
+        ply_cursor cur;
+        size_t r, nf = 0U;
+
+        cur.p = c->s; cur.e = c->e; cur.fmt = j->pf->fmt; cur.ok = true;
+        for (r = 0; r < c->n && cur.ok; ++r)
+        {
+            unsigned short idx[IMPORT_POLY_MAX];
+            size_t n = 0U, k, t;
+            plane pl;
+
+            memset(&pl, 0, sizeof(pl));
+            ply_record(&cur, j->pf->face, NULL, idx, &n, &pl);
+            if (n > IMPORT_POLY_MAX) n = IMPORT_POLY_MAX;
+
+            /* Stored planes use this pool's form: m.x - d, unit m. One
+             * with no usable normal is zeroed, for import_check to redo */
+            if (j->write && j->pf->planes)
+            {
+                float const len = sqrtf(pl.m[0]*pl.m[0] + pl.m[1]*pl.m[1] +
+                                        pl.m[2]*pl.m[2]);
+                if (len > 0.0f && len <= FLT_MAX)
+                {
+                    pl.m[0] /= len;
+                    pl.m[1] /= len;
+                    pl.m[2] /= len;
+                    pl.d    /= len;
+                }
+                else
+                {
+                    memset(&pl, 0, sizeof(pl));
+                }
+                pl.rel = PLANE_REL_LEFT;
+            }
+
+            if (j->write)
+            {
+                t = import_fan(j->out->faces + c->of + nf, idx, n);
+                if (j->pf->planes)
+                    for (k = 0; k < t; ++k)
+                        j->out->planes[c->of + nf + k] = pl;
+            }
+            nf += n < 3 ? 0U : n - 2;
+        }
+        c->nf = nf;
+    }
+}
+
+/* Drops faces indexing past the vertex pool or forming no plane, keeping
+ * planes aligned: the pools_check and pools_make_planes passes for pools
+ * whose planes were read. A stored plane with no normal is recomputed. */
+static void
+import_check(pools *out)
+{
+    size_t i, w = 0U, nv = out->n_verts, n_bad = 0U, n_flat = 0U;
+
+    for (i = 0; i < out->n_faces; ++i)
+    {
+        face  *f = out->faces + i;
+        plane  pl;
+
+        if (f->i[0] >= nv || f->i[1] >= nv || f->i[2] >= nv)
+        {
+            VERBOSE_3
+            (
+                fprintf(stderr,
+                        "Face %zu contains an index that exceeds the vertex "
+                        "pool and will be deleted.\n", i);
+            )
+            ++n_bad;
+            continue;
+        }
+        if (!plane_from_face(&pl, out->verts, f))
+        {
+            VERBOSE_3
+            (
+                fprintf(stderr,
+                        "Face %zu does not form a plane and will be "
+                        "deleted.\n", i);
+            )
+            ++n_flat;
+            continue;
+        }
+        out->faces [w] = *f;
+        out->planes[w] = out->planes[i].m[0] == 0.0f &&
+                         out->planes[i].m[1] == 0.0f &&
+                         out->planes[i].m[2] == 0.0f ? pl : out->planes[i];
+        ++w;
+    }
+
+    if (n_bad)
+    {
+        fprintf(stderr, "%zu faces contain an index that exceeds the vertex "
+                        "pool and were deleted.\n", n_bad);
+    }
+    if (n_flat)
+    {
+        fprintf(stderr, "%zu faces do not form a plane and were deleted.\n",
+                n_flat);
+    }
+    out->n_faces = w;
+}
+
+bool
+import_ply(pools *out, char const *path, unsigned threads, bool *planed)
+{
+    ply_file pf;
+    import_chunk *c = NULL;
+    import_ply_job j;
+    char const *body;
+    char *buf;
+    size_t sz, n, nv, nf, i, k;
+    bool ok = false;
+
+    if (!out || !path) return false;
+    if (planed) *planed = false;
+
+    buf = import_load(path, &sz);
+    if (!buf)
+    {
+        fprintf(stderr, "Failed to read \"%s\".\n", path);
+        return false;
+    }
+
+    n = import_chunks(threads);
+    c = malloc(n * sizeof(import_chunk));
+    if (!c) goto L_Done;
+
+    if (!ply_header(&pf, buf, sz, &body) || !pf.vert || !pf.face ||
+        !ply_locate(&pf, body, buf + sz, c, n))
+    {
+        fprintf(stderr, "\"%s\" is not a PLY file this importer reads.\n",
+                path);
+        goto L_Done;
+    }
+
+    /* Planes are used only when all four parts are present */
+    k = 0U;
+    for (i = 0; i < pf.face->np; ++i)
+        if (pf.face->p[i].role >= PLY_ROLE_NX) k |= 1U << (pf.face->p[i].role -
+                                                           PLY_ROLE_NX);
+    pf.planes = k == 0xF;
+
+    nv = pf.vert->n;
+    if (nv > 0xFFFF)
+    {
+        fprintf(stderr, "\"%s\" has %zu vertices, over the 16-bit index "
+                        "limit.\n", path, nv);
+        goto L_Done;
+    }
+
+    j.pf  = &pf;
+    j.c   = c;
+    j.out = out;
+
+    /* Count triangles per face chunk, then place and fill */
+    ply_split(c, n, &pf, pf.face);
+    j.write = false;
+    thread_for(import_ply_faces, &j, n, (unsigned)n);
+    import_offsets(c, n, &i, &nf);
+
+    if (!nv || !nf)
+    {
+        fprintf(stderr, "\"%s\" has no geometry.\n", path);
+        goto L_Done;
+    }
+    if (!pools_alloc_raw(out, nv, nf))
+    {
+        fprintf(stderr, "Failed to allocate pools.\n");
+        goto L_Done;
+    }
+
+    j.write = true;
+    thread_for(import_ply_faces, &j, n, (unsigned)n);
+
+    ply_split(c, n, &pf, pf.vert);
+    thread_for(import_ply_verts, &j, n, (unsigned)n);
+
+    if (pf.planes)
+    {
+        import_check(out);
+        if (planed) *planed = true;
+    }
+    ok = true;
+
+L_Done:
+    free(c);
+    free(buf);
+    return ok;
+}
+
+
+
+bool
+import_file(pools *out, char const *path, unsigned threads, bool *planed)
+{
+    char const *dot;
+
+    if (planed) *planed = false;
+    if (!path) return false;
+
+    dot = strrchr(path, '.');
+    if (dot && (!strcmp(dot, ".obj") || !strcmp(dot, ".OBJ")))
+        return import_obj(out, path, threads);
+    if (dot && (!strcmp(dot, ".ply") || !strcmp(dot, ".PLY")))
+        return import_ply(out, path, threads, planed);
+
+    VERBOSE_2
+    (
+        fprintf(stderr, "WARNING: import_file(\"%s\") unknown format.\n", path);
+    )
+    return false;
+}
+
+bool
+import_is_supported(char const *path)
+{
+    char const *dot = path ? strrchr(path, '.') : NULL;
+
+    return dot && (!strcmp(dot, ".obj") || !strcmp(dot, ".OBJ") ||
+                   !strcmp(dot, ".ply") || !strcmp(dot, ".PLY"));
+}
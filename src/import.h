@@ -0,0 +1,27 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Geometry importers for interchange formats (Wavefront OBJ, Stanford PLY).
+    Files are parsed in parallel chunks straight into the pools: a first pass
+    counts what each chunk holds, a second writes it at its final offset.
+*******************************************************************************/
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "pools.h"
+
+/* Polygons are fanned into triangles. `threads` = 0 uses every processor.
+ * Faces with bad indices are left for pools_check, except when *planed is
+ * set: the planes came from the file, the faces are checked, and neither
+ * pools_check nor pools_make_planes should run. */
+bool import_obj (pools *out, char const *path, unsigned threads);
+bool import_ply (pools *out, char const *path, unsigned threads, bool *planed);
+bool import_file(pools *out, char const *path, unsigned threads, bool *planed);
+
+/* True for paths import_file() reads (by extension) */
+bool import_is_supported(char const *path);
+
+#endif /* IMPORT_H */
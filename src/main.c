@@ -9,24 +9,130 @@
 #include "bsp.h"
 #include "data.h"
 #include "draw.h"
+#include "import.h"
+#include "mem.h"
+#include "pack.h"
+#include "perf.h"
+#include "replay.h"
 #include "select.h"
+#include "trace.h"
 #include "window.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 void usage(void);
 void cleanup(void);
 
 
-pools g_pool;
-bsp   g_bsp;
+pools      g_pool;
+bsp        g_bsp;
+perf_group g_perf;
+
+replay_log  g_record;               /* First build, written to g_record_out */
+replay_view g_replay;               /* Log being stepped through, if any */
+char const *g_record_out = NULL;
+bool        g_shrink = false;       /* Cut capacity to fit after builds */
+
+static char const *trace_out = NULL;
 
 
 int main(int argc, char **argv)
 {
-    if (argc != 2)
+    bool mapped = false, streamed = false, ready = false, sidecar = false;
+    bool arena = false, huge = false, counters = false, lazy = false;
+    bool moved = false;
+    perf_counts c0, c_load = {{0}}, c_planes = {{0}};
+    pools_rejects rej_check = {0}, rej_planes = {0};
+    char const *pack_out = NULL, *replay_in = NULL;
+    unsigned pack_bits = PACK_BITS_DEFAULT, fps = 60U;
+    float weld = -1.0f; /* Off */
+
+    for (; argc > 2 && argv[1][0] == '-'; ++argv, --argc)
+    {
+        if (!strcmp(argv[1], "-m"))
+        {
+            mapped = true;
+        }
+        else if (!strcmp(argv[1], "-s"))
+        {
+            streamed = true;
+        }
+        else if (!strcmp(argv[1], "-a"))
+        {
+            arena = true;
+        }
+        else if (!strcmp(argv[1], "-H"))
+        {
+            arena = huge = true;
+        }
+        else if (!strcmp(argv[1], "-c"))
+        {
+            counters = true;
+        }
+        else if (!strcmp(argv[1], "-f"))
+        {
+            g_shrink = true;
+        }
+        else if (!strcmp(argv[1], "-d"))
+        {
+            lazy = true;
+        }
+        else if (!strcmp(argv[1], "-F") && argc > 3)
+        {
+            fps = (unsigned)strtoul(argv[2], NULL, 10);
+            if (!fps) break;
+            ++argv;
+            --argc;
+        }
+        else if (!strcmp(argv[1], "-t") && argc > 3)
+        {
+            trace_out = argv[2];
+            ++argv;
+            --argc;
+        }
+        else if (!strcmp(argv[1], "-R") && argc > 3)
+        {
+            g_record_out = argv[2];
+            ++argv;
+            --argc;
+        }
+        else if (!strcmp(argv[1], "-r") && argc > 3)
+        {
+            replay_in = argv[2];
+            ++argv;
+            --argc;
+        }
+        else if (!strcmp(argv[1], "-P"))
+        {
+            sidecar = true;
+        }
+        else if (!strcmp(argv[1], "-w") && argc > 3)
+        {
+            char *end;
+
+            weld = strtof(argv[2], &end);
+            if (end == argv[2] || !(weld >= 0.0f)) break;
+            ++argv;
+            --argc;
+        }
+        else if (!strcmp(argv[1], "-p") && argc > 4)
+        {
+            pack_bits = (unsigned)strtoul(argv[2], NULL, 10);
+            pack_out  = argv[3];
+            argv += 2;
+            argc -= 2;
+        }
+        else break;
+    }
+    if (argc != 2 || (mapped && streamed) || (g_record_out && replay_in) ||
+        ((mapped || streamed) && (pack_is_supported(argv[1]) ||
+                                  import_is_supported(argv[1]))) ||
+        (sidecar && (streamed || weld >= 0.0f ||
+                     import_is_supported(argv[1]) ||
+                     pack_is_supported(argv[1]))))
     {
         usage();
         return EXIT_FAILURE;
@@ -36,24 +142,116 @@ int main(int argc, char **argv)
     pools_init(&g_pool);
     bsp_init(&g_bsp);
 
-    if (!read_data(&g_pool, argv[1]))
+    if (trace_out && !trace_start(0U))
+    {
+        fprintf(stderr, "Exiting due to trace error.\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Unavailable counters read as zeros: carry on without them */
+    if (counters) perf_open(&g_perf);
+    perf_read(&g_perf, &c0);
+
+    if (import_is_supported(argv[1]))
+    {
+        /* OBJ / PLY: planes stored in the file are used as they are */
+        if (!import_file(&g_pool, argv[1], 0U, &ready))
+        {
+            fprintf(stderr, "Exiting due to import error.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    else if (pack_is_supported(argv[1]))
+    {
+        if (!pack_read(&g_pool, argv[1]))
+        {
+            fprintf(stderr, "Exiting due to data read error.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    else if (streamed)
+    {
+        /* Checked and planed while loading */
+        if (!read_data_stream(&g_pool, argv[1]))
+        {
+            fprintf(stderr, "Exiting due to data read error.\n");
+            return EXIT_FAILURE;
+        }
+        ready = true;
+    }
+    else
+    {
+        /* A sidecar only matches the faces as read, before weld */
+        bool *planed = sidecar || weld >= 0.0f ? NULL : &ready;
+
+        if (!(mapped ? read_data_mapped(&g_pool, argv[1], planed)
+                     : read_data       (&g_pool, argv[1], planed)))
+        {
+            fprintf(stderr, "Exiting due to data read error.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    perf_accum(&g_perf, &c0, &c_load);
+
+    if (weld >= 0.0f && !pools_weld(&g_pool, weld, &moved))
     {
-        fprintf(stderr, "Exiting due to data read error.\n");
+        fprintf(stderr, "Exiting due to weld error.\n");
         return EXIT_FAILURE;
     }
 
-    if (!pools_check(&g_pool))
+    perf_read(&g_perf, &c0);
+    if (!ready && !pools_check(&g_pool, sidecar ? &rej_check : NULL))
     {
         fprintf(stderr, "Exiting due to pool check error.\n");
         return EXIT_FAILURE;
     }
 
-    if (!pools_make_planes(&g_pool))
+    /* Planes read with the faces no longer fit any the weld moved */
+    if ((!ready || moved) &&
+        !pools_make_planes(&g_pool, sidecar ? &rej_planes : NULL))
     {
         fprintf(stderr, "Exiting due to plane error.\n");
         return EXIT_FAILURE;
     }
+    perf_accum(&g_perf, &c0, &c_planes);
+
+    if (perf_on(&g_perf))
+    {
+        perf_print(stdout, "load",   &c_load,   g_perf.mask);
+        perf_print(stdout, "planes", &c_planes, g_perf.mask);
+    }
+
+    if (sidecar)
+    {
+        bool ok = write_planes(&g_pool, argv[1], &rej_check, &rej_planes);
+
+        pools_rejects_free(&rej_check);
+        pools_rejects_free(&rej_planes);
+        if (!ok) fprintf(stderr, "Plane file not written.\n");
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (pack_out)
+    {
+        return pack_write(&g_pool, pack_out, pack_bits) ? EXIT_SUCCESS
+                                                        : EXIT_FAILURE;
+    }
+
+    if (replay_in && !(replay_read(&g_replay.log, replay_in) &&
+                       replay_view_begin(&g_replay, &g_pool)))
+    {
+        fprintf(stderr, "Exiting due to build log error.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (arena && !pools_arena(&g_pool, 0U, huge))
+    {
+        fprintf(stderr, "Exiting due to arena reservation error.\n");
+        return EXIT_FAILURE;
+    }
 
+    window_set_rate(fps, lazy);
     window_init_default();
     draw_init();
 
@@ -62,14 +260,50 @@ int main(int argc, char **argv)
 
 void cleanup(void)
 {
+    if (trace_out && !trace_dump(trace_out))
+        fprintf(stderr, "Trace file not written.\n");
+    trace_stop();
     draw_cleanup();
     window_cleanup();
+    mem_report(stderr, &g_pool, &g_bsp);
     bsp_free(&g_bsp);
     pools_free(&g_pool);
+    perf_close(&g_perf);
+    replay_log_free(&g_record);
+    replay_log_free(&g_replay.log);
 }
 
 void usage(void)
 {
-    fprintf(stderr, "Usage:\n  bsp obj_name\n");
+    fprintf(stderr, "Usage:\n  bsp [-m | -s] [-a | -H] [-c] [-f] [-d] [-F fps] "
+                    "[-t out.json]\n      [-R out.bsr | -r in.bsr] [-w tol] "
+                    "[-p bits out.bsz] obj_name\n"
+                    "  bsp [-m] -P obj_name\n"
+                    "  bsp [-a | -H] [-c] [-f] [-d] [-F fps] [-t out.json]\n"
+                    "      [-R out.bsr | -r in.bsr] [-w tol] "
+                    "[-p bits out.bsz] "
+                    "file.obj | file.ply | file.bsz\n"
+                    "    -a  grow the pools in place in reserved address "
+                    "space\n"
+                    "    -H  as -a, backed by huge pages where available\n"
+                    "    -c  count cycles, instructions, cache and branch "
+                    "misses\n        per phase and tree depth (Linux)\n"
+                    "    -f  cut the pools and tree to fit after each build\n"
+                    "    -d  draw only after input or while moving, sleeping "
+                    "otherwise\n"
+                    "    -F  frames per second to aim for (default 60)\n"
+                    "    -t  record a timeline of loads, builds and frames "
+                    "to a Chrome\n        trace_event file\n"
+                    "    -R  record the events of the first build to a log\n"
+                    "    -r  step through a recorded build with Return "
+                    "instead of building\n"
+                    "    -m  map the geometry files instead of reading them\n"
+                    "    -s  stream the faces, checking them as they load\n"
+                    "    -P  write the planes to obj_name.PLN, used by later "
+                    "loads\n"
+                    "    -w  weld vertices closer than tol (0 = exact "
+                    "duplicates)\n"
+                    "    -p  pack the checked input into a compressed file, "
+                    "snapping\n        vertices to a 2^bits grid (1-16)\n");
 }
 
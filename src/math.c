@@ -24,6 +24,9 @@ plane_from_face(
 
     if (!out || !verts || !f) return false;
 
+    /* The pool may not be cleared (mapped or streamed loads) */
+    out->rel = PLANE_REL_LEFT;
+
     /* Faces wound clockwise are considered 'front facing' */
     vs[0] = verts+f->i[0];
     vs[1] = verts+f->i[2];
@@ -74,6 +77,87 @@ plane_from_face(
 
 
 
+size_t
+plane_from_faces(
+    plane *out,
+    unsigned char *ok,
+    vert const *verts,
+    face const *f,
+    size_t n)
+{
+    /* One array per component and lane, so each step is one vector op */
+    double ax[PLANE_LANES], ay[PLANE_LANES], az[PLANE_LANES],
+           bx[PLANE_LANES], by[PLANE_LANES], bz[PLANE_LANES],
+           cx[PLANE_LANES], cy[PLANE_LANES], cz[PLANE_LANES],
+           nx[PLANE_LANES], ny[PLANE_LANES], nz[PLANE_LANES],
+           nd[PLANE_LANES], ng[PLANE_LANES];
+    size_t i, k, m, made = 0U;
+
+    if (!out || !ok || !verts || !f) return 0U;
+
+    for (i = 0; i < n; i += PLANE_LANES)
+    {
+        m = n - i < PLANE_LANES ? n - i : PLANE_LANES;
+
+        /* Gather (clockwise: corners 0, 2, 1), padding the last group with
+         * its first face */
+        for (k = 0; k < PLANE_LANES; ++k)
+        {
+            face const *fk = f + i + (k < m ? k : 0U);
+            vert const *a = verts + fk->i[0],
+                       *b = verts + fk->i[2],
+                       *c = verts + fk->i[1];
+
+            ax[k] = a->m[0]; ay[k] = a->m[1]; az[k] = a->m[2];
+            bx[k] = b->m[0]; by[k] = b->m[1]; bz[k] = b->m[2];
+            cx[k] = c->m[0]; cy[k] = c->m[1]; cz[k] = c->m[2];
+        }
+
+        /* As plane_from_face, step for step, but with the degenerate case
+         * selected rather than branched to */
+        for (k = 0; k < PLANE_LANES; ++k)
+        {
+            double const e0x = bx[k] - ax[k], e0y = by[k] - ay[k],
+                         e0z = bz[k] - az[k],
+                         e1x = cx[k] - ax[k], e1y = cy[k] - ay[k],
+                         e1z = cz[k] - az[k];
+            double x, y, z, mag, g;
+
+            x   = (e0y*e1z) - (e0z*e1y);
+            y   = (e0z*e1x) - (e0x*e1z);
+            z   = (e0x*e1y) - (e0y*e1x);
+            mag = (x*x) + (y*y) + (z*z);
+            g   = mag >= DBL_EPSILON ? 1.0 : 0.0;
+            mag = sqrt(mag + (1.0 - g));
+            x   = x / mag * g;
+            y   = y / mag * g;
+            z   = z / mag * g;
+
+            nx[k] = x;
+            ny[k] = y;
+            nz[k] = z;
+            nd[k] = (x*ax[k]) + (y*ay[k]) + (z*az[k]);
+            ng[k] = g;
+        }
+
+        for (k = 0; k < m; ++k)
+        {
+            plane *p = out + i + k;
+
+            p->m[0] = (float)nx[k];
+            p->m[1] = (float)ny[k];
+            p->m[2] = (float)nz[k];
+            p->d    = (float)nd[k];
+            p->rel  = PLANE_REL_LEFT;
+            ok[i+k] = ng[k] != 0.0;
+            made   += ok[i+k];
+        }
+    }
+    return made;
+}
+
+
+
 bool
 normal_from_face(
     float *out,
@@ -130,3 +214,40 @@ normal_from_face(
     return true;
 }
 
+
+
+/* pt is assumed to lie on the plane p of the face. Points on an edge count
+ * as contained. Either winding is accepted. */
+bool
+face_contains_point(
+    plane const *p,
+    vert const *verts,
+    face const *f,
+    float const *pt)
+{
+    vert const *vs[3];
+    float e[3], w[3], c[3], s[3];
+    unsigned char k;
+
+    if (!p || !verts || !f || !pt) return false;
+
+    vs[0] = verts + f->i[0];
+    vs[1] = verts + f->i[1];
+    vs[2] = verts + f->i[2];
+
+    /* Side of each edge the point falls on, measured along the normal */
+    for (k = 0; k < 3; ++k)
+    {
+        vec3_sub(e, vs[k == 2 ? 0 : k+1]->m, vs[k]->m);
+        vec3_sub(w, pt, vs[k]->m);
+        vec3_cross(c, e, w);
+        s[k] = vec3_dot(c, p->m);
+    }
+
+    /* A collapsed face (e.g. a clipping sliver) contains nothing */
+    if (s[0] == 0.0f && s[1] == 0.0f && s[2] == 0.0f)
+        return false;
+
+    return (s[0] >= 0.0f && s[1] >= 0.0f && s[2] >= 0.0f) ||
+           (s[0] <= 0.0f && s[1] <= 0.0f && s[2] <= 0.0f);
+}
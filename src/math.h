@@ -14,6 +14,7 @@
 #include "plane.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <math.h>
 #include <float.h>
 
@@ -23,12 +24,31 @@ bool plane_from_face(
     vert const *verts,
     face *f);
 
+/* plane_from_face over n faces, PLANE_LANES at a time in branch-free lanes
+ * the compiler can vectorise. The same double precision steps in the same
+ * order: without FMA contraction the planes match plane_from_face exactly,
+ * with it to within one float ulp. ok[i] says whether face i formed a plane
+ * (otherwise its plane is zeroed). Returns how many did. */
+#define PLANE_LANES 8
+size_t plane_from_faces(
+    plane *out,
+    unsigned char *ok,
+    vert const *verts,
+    face const *f,
+    size_t n);
+
 bool normal_from_face(
     float *out,
     vert const *verts,
     face *f,
     bool normalise);
 
+bool face_contains_point(
+    plane const *p,
+    vert const *verts,
+    face const *f,
+    float const *pt);
+
 
 static inline void
 vec3_add(float *out,
@@ -78,15 +98,58 @@ vec3_dot(float const *a,
     return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
 }
 
-/*static inline float 
-vec3_distance_to_plane(plane const *p,
-                       float const *a)
+/* 0 to 1 from a linear congruential step: the same on every platform, so
+ * generated scenes and sample points repeat exactly */
+static inline float
+math_rand(unsigned *s)
+{
+    *s = *s * 1103515245U + 12345U;
+    return (float)((*s >> 8) & 0xFFFFU) / 65535.0f;
+}
+
+
+
+/* Precision of plane distances, projections and ray intersections, chosen
+ * at build time (make PRECISION=FLOAT, DOUBLE or FILTERED):
+ *   PRECISION_FLOAT     float throughout
+ *   PRECISION_DOUBLE    each step widened to double, results rounded to float
+ *   PRECISION_FILTERED  distances in float, redone in double only where the
+ *                       float result lies within its rounding error of
+ *                       +-PLANE_EPSILON, so every side of the band taken is
+ *                       the one PRECISION_DOUBLE takes (the sign of a point
+ *                       on the plane may not be). Intersections stay double:
+ *                       the vertices they make are classified from then on,
+ *                       and the trees come out the same. */
+#define PRECISION_FLOAT    1
+#define PRECISION_DOUBLE   2
+#define PRECISION_FILTERED 3
+#ifndef PRECISION
+#define PRECISION PRECISION_DOUBLE
+#endif
+#if PRECISION != PRECISION_FLOAT && PRECISION != PRECISION_DOUBLE && \
+    PRECISION != PRECISION_FILTERED
+#error "PRECISION must be PRECISION_FLOAT, _DOUBLE or _FILTERED"
+#endif
+
+/* Points closer than this to a plane are on it */
+#define PLANE_EPSILON FLT_EPSILON
+
+/* Rounding error of a float dot product of three terms less a fourth, per
+ * unit of the terms' absolute sum: twice the worst case */
+#define PRECISION_FILTER (4.0f * FLT_EPSILON)
+
+
+
+static inline float
+vec3_distance_to_plane_f(plane const *p,
+                         float const *a)
 {
     return vec3_dot(p->m, a) - p->d;
-}*/
+}
+
 static inline float 
-vec3_distance_to_plane(plane const *p,
-                       float const *a)
+vec3_distance_to_plane_d(plane const *p,
+                         float const *a)
 {
     return (float)
         (((double)a[0] * (double)p->m[0]  +
@@ -95,31 +158,116 @@ vec3_distance_to_plane(plane const *p,
           (double)p->d);
 }
 
+/* Float, unless the result may be on the wrong side of +-PLANE_EPSILON */
+static inline float
+vec3_distance_to_plane_filtered(plane const *p,
+                                float const *a)
+{
+    float const x = a[0]*p->m[0], y = a[1]*p->m[1], z = a[2]*p->m[2];
+    float const d = x + y + z - p->d;
+    float const e = (fabsf(x) + fabsf(y) + fabsf(z) + fabsf(p->d)) *
+                    PRECISION_FILTER;
+
+    return fabsf(fabsf(d) - PLANE_EPSILON) > e ?
+           d : vec3_distance_to_plane_d(p, a);
+}
 
+static inline float 
+vec3_distance_to_plane(plane const *p,
+                       float const *a)
+{
+#if PRECISION == PRECISION_FLOAT
+    return vec3_distance_to_plane_f(p, a);
+#elif PRECISION == PRECISION_DOUBLE
+    return vec3_distance_to_plane_d(p, a);
+#else
+    return vec3_distance_to_plane_filtered(p, a);
+#endif
+}
 
+/* Sides of n points, given by coordinate, of the +-PLANE_EPSILON band about
+ * the plane: side[i] is PLANE_SIDE_NEG, PLANE_SIDE_POS or 0 (on it), as
+ * vec3_distance_to_plane takes them. Flat loops the compiler can vectorise;
+ * under PRECISION_FILTERED the few lanes it flags are redone in double. */
+#define PLANE_SIDE_NEG  1U
+#define PLANE_SIDE_POS  2U
+#define PLANE_SIDE_REDO 4U /* PRECISION_FILTERED: lane needs double */
 static inline void
-vec3_project_plane(plane const *p,
-                   float       *out,
-                   float const *in)
+vec3_side_of_plane_lanes(plane const *p,
+                         float const *x, float const *y, float const *z,
+                         unsigned char *side, size_t n)
 {
-    /* Dot product */
-    double const dist =
-        ((double)p->m[0] * (double)in[0]) +
-        ((double)p->m[1] * (double)in[1]) +
-        ((double)p->m[2] * (double)in[2]) -
-        (double)p->d;
+    size_t i;
 
-    out[0] = (float)((double)in[0] - (dist * (double)p->m[0]));
-    out[1] = (float)((double)in[1] - (dist * (double)p->m[1]));
-    out[2] = (float)((double)in[2] - (dist * (double)p->m[2]));
+#if PRECISION == PRECISION_FLOAT
+    for (i = 0; i < n; ++i)
+    {
+        float const d = x[i]*p->m[0] + y[i]*p->m[1] + z[i]*p->m[2] - p->d;
+
+        side[i] = (unsigned char)((d <= -PLANE_EPSILON) |
+                                  (d >=  PLANE_EPSILON) << 1);
+    }
+#elif PRECISION == PRECISION_DOUBLE
+    for (i = 0; i < n; ++i)
+    {
+        float const d = (float)
+            (((double)x[i] * (double)p->m[0]  +
+              (double)y[i] * (double)p->m[1]  +
+              (double)z[i] * (double)p->m[2]) -
+              (double)p->d);
+
+        side[i] = (unsigned char)((d <= -PLANE_EPSILON) |
+                                  (d >=  PLANE_EPSILON) << 1);
+    }
+#else
+    unsigned redo = 0U;
+
+    for (i = 0; i < n; ++i)
+    {
+        float const a = x[i]*p->m[0], b = y[i]*p->m[1], c = z[i]*p->m[2];
+        float const d = a + b + c - p->d;
+        float const e = (fabsf(a) + fabsf(b) + fabsf(c) + fabsf(p->d)) *
+                        PRECISION_FILTER;
+        unsigned const r = fabsf(fabsf(d) - PLANE_EPSILON) <= e;
+
+        side[i] = (unsigned char)((d <= -PLANE_EPSILON) |
+                                  (d >=  PLANE_EPSILON) << 1 | r << 2);
+        redo |= r;
+    }
+    if (!redo) return;
+    for (i = 0; i < n; ++i)
+    {
+        float a[3], d;
+
+        if (!(side[i] & PLANE_SIDE_REDO)) continue;
+        a[0] = x[i]; a[1] = y[i]; a[2] = z[i];
+        d = vec3_distance_to_plane_d(p, a);
+        side[i] = (unsigned char)((d <= -PLANE_EPSILON) |
+                                  (d >=  PLANE_EPSILON) << 1);
+    }
+#endif
 }
 
 
 
 static inline float
-vec3_project_plane_get_d(plane const *p,
-                         float       *out,
-                         float const *in)
+vec3_project_plane_get_d_f(plane const *p,
+                           float       *out,
+                           float const *in)
+{
+    float const dist = vec3_distance_to_plane_f(p, in);
+
+    out[0] = in[0] - dist * p->m[0];
+    out[1] = in[1] - dist * p->m[1];
+    out[2] = in[2] - dist * p->m[2];
+
+    return dist;
+}
+
+static inline float
+vec3_project_plane_get_d_d(plane const *p,
+                           float       *out,
+                           float const *in)
 {
     /* Dot product */
     double const dist =
@@ -135,13 +283,72 @@ vec3_project_plane_get_d(plane const *p,
     return (float)dist;
 }
 
+/* The filtered distance, and the projection in float along it */
+static inline float
+vec3_project_plane_get_d_filtered(plane const *p,
+                                  float       *out,
+                                  float const *in)
+{
+    float const dist = vec3_distance_to_plane_filtered(p, in);
 
+    out[0] = in[0] - dist * p->m[0];
+    out[1] = in[1] - dist * p->m[1];
+    out[2] = in[2] - dist * p->m[2];
 
-static inline bool
-vec3_plane_ray_intersect(plane const *p,
+    return dist;
+}
+
+static inline float
+vec3_project_plane_get_d(plane const *p,
                          float       *out,
-                         float const *l0,
-                         float const *l1)
+                         float const *in)
+{
+#if PRECISION == PRECISION_FLOAT
+    return vec3_project_plane_get_d_f(p, out, in);
+#elif PRECISION == PRECISION_DOUBLE
+    return vec3_project_plane_get_d_d(p, out, in);
+#else
+    return vec3_project_plane_get_d_filtered(p, out, in);
+#endif
+}
+
+static inline void
+vec3_project_plane(plane const *p,
+                   float       *out,
+                   float const *in)
+{
+    (void)vec3_project_plane_get_d(p, out, in);
+}
+
+
+
+static inline bool
+vec3_plane_ray_intersect_f(plane const *p,
+                           float       *out,
+                           float const *l0,
+                           float const *l1)
+{
+    float l[3], ldN;
+
+    vec3_sub(l, l1, l0);
+    ldN = vec3_dot(l, p->m);
+    if (fabsf(ldN) >= FLT_EPSILON)
+    {
+        float const a = (p->d - vec3_dot(l0, p->m)) / ldN;
+
+        out[0] = l0[0] + a*l[0];
+        out[1] = l0[1] + a*l[1];
+        out[2] = l0[2] + a*l[2];
+        return true;
+    }
+    return false;
+}
+
+static inline bool
+vec3_plane_ray_intersect_d(plane const *p,
+                           float       *out,
+                           float const *l0,
+                           float const *l1)
 {
     /* Derive line direction vector */
     double const l[3] =
@@ -176,6 +383,19 @@ vec3_plane_ray_intersect(plane const *p,
     return false;
 }
 
+static inline bool
+vec3_plane_ray_intersect(plane const *p,
+                         float       *out,
+                         float const *l0,
+                         float const *l1)
+{
+#if PRECISION == PRECISION_FLOAT
+    return vec3_plane_ray_intersect_f(p, out, l0, l1);
+#else
+    return vec3_plane_ray_intersect_d(p, out, l0, l1);
+#endif
+}
+
 
 
 static inline void mat4_transpose(float *mat)
@@ -0,0 +1,130 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Accounts for the memory held by the pools and the tree: current and peak
+    bytes by kind, the capacity past what is in use, and the pools' growth.
+*******************************************************************************/
+
+#include "mem.h"
+
+mem_stats g_mem;
+
+static char const *const mem_names[MEM_KINDS] =
+    { "verts", "faces", "planes", "nodes", "boxes", "scratch" };
+
+
+
+void
+mem_track(MEM_KIND kind, size_t from, size_t to)
+{
+    if (kind >= MEM_KINDS || from == to) return;
+
+    /* Never below zero, whatever a caller's mistake */
+    from = from < g_mem.cur[kind] ? from : g_mem.cur[kind];
+
+    g_mem.cur[kind] = g_mem.cur[kind] - from + to;
+    g_mem.total     = g_mem.total     - from + to;
+    ++g_mem.n_changes;
+
+    if (g_mem.cur[kind] > g_mem.peak[kind]) g_mem.peak[kind] = g_mem.cur[kind];
+    if (g_mem.total > g_mem.total_peak)     g_mem.total_peak = g_mem.total;
+    if (g_mem.total > g_mem.mark_peak)      g_mem.mark_peak  = g_mem.total;
+}
+
+void
+mem_grew(double sec)
+{
+    ++g_mem.n_grow;
+    g_mem.t_grow += sec;
+}
+
+void
+mem_mark(void)
+{
+    g_mem.mark_peak = g_mem.total;
+}
+
+char const *
+mem_name(MEM_KIND kind)
+{
+    return kind < MEM_KINDS ? mem_names[kind] : "?";
+}
+
+
+
+/* Bytes of each kind in use: counts, not capacities */
+static void
+mem_used(pools const *pool, bsp const *tree, size_t *used)
+{
+    unsigned k;
+
+    for (k = 0; k < MEM_KINDS; ++k) used[k] = g_mem.cur[k];
+    if (pool)
+    {
+        used[MEM_VERTS]  = pool->n_verts * sizeof(vert);
+        used[MEM_FACES]  = pool->n_faces * sizeof(face);
+        used[MEM_PLANES] = pool->n_faces * sizeof(plane);
+    }
+    if (tree)
+    {
+        used[MEM_NODES] = tree->occ * sizeof(bsp_node);
+        used[MEM_BOXES] = tree->occ * sizeof(bsp_box);
+    }
+
+    /* Never past what is held, e.g. mapped pools cut short */
+    for (k = 0; k < MEM_KINDS; ++k)
+        if (used[k] > g_mem.cur[k]) used[k] = g_mem.cur[k];
+}
+
+void
+mem_report(FILE *f, pools const *pool, bsp const *tree)
+{
+    size_t used[MEM_KINDS], in_use = 0U;
+    unsigned k;
+
+    if (!f) return;
+    mem_used(pool, tree, used);
+
+    fprintf(f, "%-12s %10s %8s %8s %8s\n", "Memory (KiB)", "held", "used",
+               "unused", "peak");
+    for (k = 0; k < MEM_KINDS; ++k)
+    {
+        in_use += used[k];
+        fprintf(f, "  %-10s %10zu %8zu %8zu %8zu\n", mem_names[k],
+                g_mem.cur[k] >> 10, used[k] >> 10,
+                (g_mem.cur[k] - used[k]) >> 10, g_mem.peak[k] >> 10);
+    }
+    fprintf(f, "  %-10s %10zu %8zu %8zu %8zu (last build %zu)\n", "total",
+            g_mem.total >> 10, in_use >> 10, (g_mem.total - in_use) >> 10,
+            g_mem.total_peak >> 10, g_mem.mark_peak >> 10);
+    fprintf(f, "  Pools (%s) grown %zu times in %.3f ms.\n",
+            pool && pool->r_faces ? "arena" : "heap", g_mem.n_grow,
+            g_mem.t_grow * 1e3);
+}
+
+bool
+mem_json(FILE *f, pools const *pool, bsp const *tree)
+{
+    size_t used[MEM_KINDS], in_use = 0U;
+    unsigned k;
+
+    if (!f) return false;
+    mem_used(pool, tree, used);
+
+    fputc('{', f);
+    for (k = 0; k < MEM_KINDS; ++k)
+    {
+        in_use += used[k];
+        fprintf(f, "\"%s\": {\"held\": %zu, \"used\": %zu, \"peak\": %zu}, ",
+                mem_names[k], g_mem.cur[k], used[k], g_mem.peak[k]);
+    }
+    fprintf(f, "\"held\": %zu, \"used\": %zu, \"unused\": %zu, "
+               "\"peak\": %zu, \"build_peak\": %zu, \"grown\": %zu, "
+               "\"grow_ms\": %.3f}",
+               g_mem.total, in_use, g_mem.total - in_use, g_mem.total_peak,
+               g_mem.mark_peak, g_mem.n_grow, g_mem.t_grow * 1e3);
+
+    return !ferror(f);
+}
@@ -0,0 +1,62 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Accounts for the memory held by the pools and the tree: current and peak
+    bytes by kind, the capacity past what is in use, and the pools' growth.
+*******************************************************************************/
+
+#ifndef MEM_H
+#define MEM_H
+
+#include "bsp.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    MEM_VERTS = 0,  /* Pools */
+    MEM_FACES,
+    MEM_PLANES,
+    MEM_NODES,      /* Tree */
+    MEM_BOXES,
+    MEM_SCRATCH,    /* Working arrays of pool passes */
+    MEM_KINDS
+} MEM_KIND;
+
+/* Capacity held, in bytes: heap, committed arena or file mapping alike.
+ * Arena reservations count only once committed. */
+typedef struct {
+    size_t cur[MEM_KINDS], peak[MEM_KINDS];
+    size_t total, total_peak;
+    size_t mark_peak;       /* Peak total since mem_mark */
+    size_t n_changes;
+    size_t n_grow;          /* Pool growths, and seconds spent in them */
+    double t_grow;
+} mem_stats;
+
+extern mem_stats g_mem;
+
+/* Records a block of kind going from `from` bytes to `to` (0 when freed).
+ * Pools and trees are changed from one thread: this takes no lock. */
+void mem_track(MEM_KIND kind, size_t from, size_t to);
+
+/* Counts one pool growth that took sec seconds */
+void mem_grew(double sec);
+
+/* Restarts mark_peak from what is held now, e.g. as a build begins */
+void mem_mark(void);
+
+char const *mem_name(MEM_KIND kind);
+
+/* Held, in use, unused capacity and peak per kind, then the pool growths.
+ * Either of pool and tree may be NULL, leaving its kinds' use unknown
+ * (shown as held). */
+void mem_report(FILE *f, pools const *pool, bsp const *tree);
+
+/* As mem_report, one JSON object with no new line, to nest in others */
+bool mem_json(FILE *f, pools const *pool, bsp const *tree);
+
+#endif /* MEM_H */
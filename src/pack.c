@@ -0,0 +1,499 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Compressed geometry container (.BSZ).
+
+    Layout (header and table in native byte order as VTX / IDX are, bit
+    streams little-endian):
+        pack_header
+        uint32_t   bytes of each face block    [n_blocks]
+        bit packed grid x, then y, then z      [n_verts each]
+        PACK_PAD zero bytes
+        face blocks                            [n_blocks]
+
+    Vertices are stored as planes of grid coordinates, bits wide, so each
+    axis dequantises in a flat loop. Faces are coded in independent blocks
+    of PACK_BLOCK that decode as soon as the reader thread has brought them
+    in. A block is either delta coded (the first corner as
+    a zigzag delta from the previous face's, the others from the first) or
+    plain, whichever is smaller, and each of its three corner streams is
+    bit packed at one fixed width, that of its largest value in the block.
+    With no per-value lengths, decoding has no branches. It stays scalar:
+    without per-lane shifts (baseline SSE2) the bit loads cannot be
+    vectorised, and they dominate.
+
+    Block: uint8_t mode, uint8_t width[3], uint16_t first corner of the
+    first face (little-endian), packed bits, PACK_PAD zero bytes.
+*******************************************************************************/
+
+#include "pack.h"
+#include "thread.h"
+#include "verbose.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACK_VERSION 1U
+#define PACK_BLOCK   16384U      /* Faces per block */
+#define PACK_WIDTH   17U         /* Widest zigzag delta of 16 bit indices */
+#define PACK_HEAD    6U          /* Block mode, widths and base */
+#define PACK_PAD     4U          /* Block tail: bit loads never leave it */
+#define PACK_READ    (1U << 18)  /* Bytes per streamed read */
+
+
+
+typedef struct {
+    char     magic[4];      /* "BSPZ" */
+    uint16_t version;
+    uint8_t  bits;          /* Grid bits per axis */
+    uint8_t  flags;         /* Reserved, 0 */
+    uint32_t n_verts, n_faces, n_blocks;
+    float    min[3], step[3];
+} pack_header;
+
+typedef enum {
+    PACK_DELTA = 0,
+    PACK_PLAIN,
+} PACK_MODE;
+
+
+
+/* -------------------------------------------------------------------------- */
+/*  Coding                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static inline uint32_t
+pack_zig(long d)
+{
+    return d < 0 ? (uint32_t)(-d) * 2U - 1U : (uint32_t)d * 2U;
+}
+
+static inline long
+pack_unzig(uint32_t z)
+{
+    return (z & 1U) ? -(long)((z + 1U) >> 1) : (long)(z >> 1);
+}
+
+static inline unsigned
+pack_width(uint32_t v)
+{
+    unsigned w = 0U;
+    while (v) { ++w; v >>= 1; }
+    return w;
+}
+
+/* Bytes of a block of n faces with the given corner widths */
+static inline size_t
+pack_block_bytes(size_t n, unsigned w)
+{
+    return PACK_HEAD + (n * w + 7U) / 8U + PACK_PAD;
+}
+
+/* Corner values of face i in the given mode */
+static inline void
+pack_values(uint32_t *v, face const *f, size_t i, PACK_MODE mode)
+{
+    if (mode == PACK_PLAIN)
+    {
+        v[0] = f[i].i[0];
+        v[1] = f[i].i[1];
+        v[2] = f[i].i[2];
+        return;
+    }
+    v[0] = pack_zig((long)f[i].i[0] - (i ? (long)f[i-1].i[0] : f[0].i[0]));
+    v[1] = pack_zig((long)f[i].i[1] - f[i].i[0]);
+    v[2] = pack_zig((long)f[i].i[2] - f[i].i[0]);
+}
+
+/* Ors w bits of v in at bit offset b of a cleared little-endian stream */
+static inline void
+pack_put_bits(uint8_t *p, size_t b, uint32_t v)
+{
+    uint64_t x = (uint64_t)v << (b & 7U);
+
+    for (p += b >> 3; x; x >>= 8)
+        *p++ |= (uint8_t)x;
+}
+
+/* Into a cleared buffer; returns the block bytes */
+static size_t
+pack_encode_faces(uint8_t *out, face const *f, size_t n)
+{
+    unsigned w[2][3] = {{0}}, m, k;
+    uint32_t v[3];
+    size_t i, b = 0U;
+
+    for (i = 0; i < n; ++i)
+    for (m = 0; m < 2; ++m)
+    {
+        pack_values(v, f, i, (PACK_MODE)m);
+        for (k = 0; k < 3; ++k)
+            if (pack_width(v[k]) > w[m][k]) w[m][k] = pack_width(v[k]);
+    }
+    m = (w[PACK_PLAIN][0] + w[PACK_PLAIN][1] + w[PACK_PLAIN][2] <
+         w[PACK_DELTA][0] + w[PACK_DELTA][1] + w[PACK_DELTA][2]) ?
+        PACK_PLAIN : PACK_DELTA;
+
+    out[0] = (uint8_t)m;
+    out[1] = (uint8_t)w[m][0];
+    out[2] = (uint8_t)w[m][1];
+    out[3] = (uint8_t)w[m][2];
+    out[4] = (uint8_t)(n ? f[0].i[0]      : 0U);
+    out[5] = (uint8_t)(n ? f[0].i[0] >> 8 : 0U);
+
+    for (i = 0; i < n; ++i)
+    {
+        pack_values(v, f, i, (PACK_MODE)m);
+        for (k = 0; k < 3; ++k)
+        {
+            pack_put_bits(out + PACK_HEAD, b, v[k]);
+            b += w[m][k];
+        }
+    }
+    return pack_block_bytes(n, w[m][0] + w[m][1] + w[m][2]);
+}
+
+/* Up to PACK_WIDTH bits from bit offset b: four byte loads, which compilers
+ * fuse into one on little-endian hosts */
+static inline uint32_t
+pack_bits(uint8_t const *p, size_t b, unsigned w)
+{
+    uint8_t const *q = p + (b >> 3);
+    uint32_t const v = (uint32_t)q[0]       | (uint32_t)q[1] <<  8 |
+                       (uint32_t)q[2] << 16 | (uint32_t)q[3] << 24;
+    return (v >> (b & 7U)) & ((1U << w) - 1U);
+}
+
+static bool
+pack_decode_faces(face *out, size_t n, uint8_t const *p, uint8_t const *e)
+{
+    unsigned w0, w1, w2, mode;
+    long prev, i0, i1, i2;
+    size_t i, b = 0U, step;
+
+    if (e - p < (long)PACK_HEAD) return false;
+    mode = p[0];
+    w0   = p[1];
+    w1   = p[2];
+    w2   = p[3];
+    prev = (long)p[4] | (long)p[5] << 8;
+    step = (size_t)w0 + w1 + w2;
+    if (mode > PACK_PLAIN ||
+        w0 > PACK_WIDTH || w1 > PACK_WIDTH || w2 > PACK_WIDTH ||
+        (size_t)(e - p) != pack_block_bytes(n, (unsigned)step)) return false;
+    p += PACK_HEAD;
+
+    if (mode == PACK_PLAIN)
+    {
+        for (i = 0; i < n; ++i, b += step)
+        {
+            i0 = (long)pack_bits(p, b,           w0);
+            i1 = (long)pack_bits(p, b + w0,      w1);
+            i2 = (long)pack_bits(p, b + w0 + w1, w2);
+            if ((i0 | i1 | i2) > 0xFFFFL) return false;
+
+            out[i].i[0] = (unsigned short)i0;
+            out[i].i[1] = (unsigned short)i1;
+            out[i].i[2] = (unsigned short)i2;
+        }
+        return true;
+    }
+
+    for (i = 0; i < n; ++i, b += step)
+    {
+        i0 = prev + pack_unzig(pack_bits(p, b,           w0));
+        i1 = i0   + pack_unzig(pack_bits(p, b + w0,      w1));
+        i2 = i0   + pack_unzig(pack_bits(p, b + w0 + w1, w2));
+        if ((unsigned long)(i0 | i1 | i2) > 0xFFFFUL) return false;
+
+        out[i].i[0] = (unsigned short)i0;
+        out[i].i[1] = (unsigned short)i1;
+        out[i].i[2] = (unsigned short)i2;
+        prev = i0;
+    }
+    return true;
+}
+
+/* Bytes of one axis of vertices */
+static inline size_t
+pack_plane_bytes(pack_header const *h)
+{
+    return ((size_t)h->n_verts * h->bits + 7U) / 8U;
+}
+
+static inline size_t
+pack_vert_bytes(pack_header const *h)
+{
+    return 3U * pack_plane_bytes(h) + PACK_PAD;
+}
+
+static void
+pack_decode_verts(vert *restrict out, pack_header const *h,
+                  uint8_t const *q)
+{
+    size_t const pb = pack_plane_bytes(h), n = h->n_verts;
+    unsigned const w = h->bits;
+    size_t i, a;
+
+    for (a = 0; a < 3; ++a, q += pb)
+    {
+        float const m = h->min[a], st = h->step[a];
+        for (i = 0; i < n; ++i)
+            out[i].m[a] = m + (float)pack_bits(q, i * w, w) * st;
+    }
+}
+
+
+
+/* -------------------------------------------------------------------------- */
+/*  Writing                                                                   */
+/* -------------------------------------------------------------------------- */
+
+bool
+pack_write(pools const *in, char const *path, unsigned bits)
+{
+    pack_header h;
+    uint32_t *sizes = NULL;
+    uint8_t  *buf   = NULL;
+    FILE     *f     = NULL;
+    size_t    i, a, n, vb, fb = 0U;
+    float     max[3], cells;
+
+    if (!in || !path) return false;
+    if (bits < PACK_BITS_MIN || bits > PACK_BITS_MAX ||
+        in->n_verts > 0xFFFFU || in->n_faces > UINT32_MAX - PACK_BLOCK)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: pack_write(\"%s\") cannot store %u bit "
+                            "grid of %zu verts.\n", path, bits, in->n_verts);
+        )
+        return false;
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "BSPZ", 4);
+    h.version  = PACK_VERSION;
+    h.bits     = (uint8_t)bits;
+    h.n_verts  = (uint32_t)in->n_verts;
+    h.n_faces  = (uint32_t)in->n_faces;
+    h.n_blocks = (uint32_t)((in->n_faces + PACK_BLOCK - 1U) / PACK_BLOCK);
+
+    /* Grid over the bounds */
+    cells = (float)((1UL << bits) - 1UL);
+    for (a = 0; a < 3; ++a)
+    {
+        h.min[a] = max[a] = in->n_verts ? in->verts[0].m[a] : 0.0f;
+        for (i = 1; i < in->n_verts; ++i)
+        {
+            if (in->verts[i].m[a] < h.min[a]) h.min[a] = in->verts[i].m[a];
+            if (in->verts[i].m[a] > max[a])   max[a]   = in->verts[i].m[a];
+        }
+        h.step[a] = (max[a] - h.min[a]) / cells;
+    }
+
+    vb    = pack_vert_bytes(&h);
+    sizes = malloc(h.n_blocks * sizeof(*sizes) + 1U);
+    buf   = calloc(vb + h.n_blocks * pack_block_bytes(PACK_BLOCK, 3U*PACK_WIDTH),
+                   1U);
+    if (!sizes || !buf) goto L_Error;
+
+    /* Vertex planes */
+    for (a = 0; a < 3; ++a)
+    for (i = 0; i < in->n_verts; ++i)
+    {
+        float const c = h.step[a] > 0.0f ?
+                        (in->verts[i].m[a] - h.min[a]) / h.step[a] : 0.0f;
+        long q = lrintf(c);
+
+        if (q < 0)            q = 0;
+        if (q > (long)cells)  q = (long)cells;
+        pack_put_bits(buf + a*pack_plane_bytes(&h), i*bits, (uint32_t)q);
+    }
+
+    /* Face blocks */
+    for (i = 0; i < h.n_blocks; ++i)
+    {
+        n = in->n_faces - i*PACK_BLOCK;
+        if (n > PACK_BLOCK) n = PACK_BLOCK;
+        sizes[i] = (uint32_t)pack_encode_faces(buf + vb + fb,
+                                               in->faces + i*PACK_BLOCK, n);
+        fb += sizes[i];
+    }
+
+    f = fopen(path, "wb");
+    if (!f ||
+        fwrite(&h, sizeof(h), 1, f) != 1 ||
+        fwrite(sizes, sizeof(*sizes), h.n_blocks, f) != h.n_blocks ||
+        fwrite(buf, 1, vb + fb, f) != vb + fb)
+        goto L_Error;
+    if (fclose(f))
+    {
+        f = NULL;
+        goto L_Error;
+    }
+
+    fprintf(stderr, "Packed \"%s\": %zu bytes (raw %zu).\n", path,
+            sizeof(h) + h.n_blocks*sizeof(*sizes) + vb + fb,
+            in->n_verts*sizeof(vert) + in->n_faces*sizeof(face));
+    free(sizes);
+    free(buf);
+    return true;
+
+L_Error:
+    fprintf(stderr, "Failed to write \"%s\".\n", path);
+    if (f) fclose(f);
+    free(sizes);
+    free(buf);
+    return false;
+}
+
+
+
+/* -------------------------------------------------------------------------- */
+/*  Reading                                                                   */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    FILE        *f;
+    uint8_t     *buf;
+    size_t       n;
+    thread_gate *gate;
+} pack_stream;
+
+/* Reader: posts the number of payload bytes read after every chunk */
+static void
+pack_stream_read(void *arg)
+{
+    pack_stream *st = arg;
+    size_t done = 0U, got;
+
+    while (done < st->n)
+    {
+        size_t want = st->n - done;
+        if (want > PACK_READ) want = PACK_READ;
+
+        got = fread(st->buf + done, 1, want, st->f);
+        done += got;
+        thread_gate_post(st->gate, done);
+        if (got != want) break;
+    }
+    thread_gate_close(st->gate);
+}
+
+bool
+pack_read(pools *out, char const *path)
+{
+    pack_header h;
+    pack_stream st;
+    thread   *reader;
+    uint32_t *sizes = NULL;
+    FILE     *f;
+    size_t    i, n, vb, at, end;
+    bool      ok = false;
+
+    if (!out || !path) return false;
+
+    memset(&st, 0, sizeof(st));
+    f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open \"%s\".\n", path);
+        return false;
+    }
+
+    if (fread(&h, sizeof(h), 1, f) != 1 ||
+        memcmp(h.magic, "BSPZ", 4) || h.version != PACK_VERSION ||
+        h.bits < PACK_BITS_MIN || h.bits > PACK_BITS_MAX || h.flags ||
+        h.n_verts > 0xFFFFU ||
+        h.n_blocks != (h.n_faces + (uint64_t)PACK_BLOCK - 1U) / PACK_BLOCK)
+    {
+        fprintf(stderr, "\"%s\" is not a supported container.\n", path);
+        goto L_Done;
+    }
+
+    sizes = malloc(h.n_blocks * sizeof(*sizes) + 1U);
+    if (!sizes || fread(sizes, sizeof(*sizes), h.n_blocks, f) != h.n_blocks)
+    {
+        fprintf(stderr, "Block table read failure.\n");
+        goto L_Done;
+    }
+
+    vb = st.n = pack_vert_bytes(&h);
+    for (i = 0; i < h.n_blocks; ++i)
+    {
+        if (sizes[i] > pack_block_bytes(PACK_BLOCK, 3U*PACK_WIDTH))
+        {
+            fprintf(stderr, "Block %zu is corrupt.\n", i);
+            goto L_Done;
+        }
+        st.n += sizes[i];
+    }
+
+    /* Nothing is cleared: every vertex and face is written below */
+    if (!pools_alloc_raw(out, h.n_verts, h.n_faces))
+    {
+        fprintf(stderr, "Failed to allocate pools.\n");
+        goto L_Done;
+    }
+
+    st.f    = f;
+    st.buf  = malloc(st.n + 1U);
+    st.gate = thread_gate_new();
+    if (!st.buf || !st.gate)
+    {
+        fprintf(stderr, "Failed to allocate stream.\n");
+        goto L_Done;
+    }
+
+    fprintf(stderr, "Num verts: %u.\nNum faces: %u.\n", h.n_verts, h.n_faces);
+
+    /* Read ahead on another thread (or up front if none can start) */
+    reader = thread_start(pack_stream_read, &st);
+    if (!reader) pack_stream_read(&st);
+
+    /* Decode each part as soon as it is in */
+    ok = thread_gate_wait(st.gate, vb) >= vb;
+    if (ok) pack_decode_verts(out->verts, &h, st.buf);
+
+    for (i = 0, at = vb; ok && i < h.n_blocks; ++i, at = end)
+    {
+        end = at + sizes[i];
+        n   = h.n_faces - i*PACK_BLOCK;
+        if (n > PACK_BLOCK) n = PACK_BLOCK;
+
+        if (thread_gate_wait(st.gate, end) < end)
+        {
+            fprintf(stderr, "Block read failure.\n");
+            ok = false;
+        }
+        else if (!pack_decode_faces(out->faces + i*PACK_BLOCK, n,
+                                    st.buf + at, st.buf + end))
+        {
+            fprintf(stderr, "Block %zu is corrupt.\n", i);
+            ok = false;
+        }
+    }
+
+    thread_join(reader);
+
+L_Done:
+    if (st.gate) thread_gate_free(st.gate);
+    free(st.buf);
+    free(sizes);
+    fclose(f);
+    return ok;
+}
+
+bool
+pack_is_supported(char const *path)
+{
+    char const *dot = path ? strrchr(path, '.') : NULL;
+
+    return dot && (!strcmp(dot, ".bsz") || !strcmp(dot, ".BSZ"));
+}
@@ -0,0 +1,31 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Compressed geometry container (.BSZ): one file holding the vertices
+    quantised to a grid over the scene bounds, and the faces as delta coded,
+    fixed width bit packed blocks that decode while the rest of the file is
+    read.
+*******************************************************************************/
+
+#ifndef PACK_H
+#define PACK_H
+
+#include "pools.h"
+
+#define PACK_BITS_MIN     1U
+#define PACK_BITS_MAX    16U
+#define PACK_BITS_DEFAULT 16U
+
+/* Writes the pools with vertices snapped to a 2^bits grid per axis */
+bool pack_write(pools const *in, char const *path, unsigned bits);
+
+/* Reads a container into empty pools. Faces are not checked and have no
+ * planes: run pools_check and pools_make_planes as for read_data. */
+bool pack_read(pools *out, char const *path);
+
+/* True for paths pack_read() reads (by extension) */
+bool pack_is_supported(char const *path);
+
+#endif /* PACK_H */
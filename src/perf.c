@@ -0,0 +1,224 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Optional hardware performance counters read around build phases. Where
+    the counters cannot be opened every read gives zeros.
+*******************************************************************************/
+
+#include "perf.h"
+#include "verbose.h"
+
+#include <string.h>
+
+#ifdef OS_LINUX
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define SELF perf_group *const self
+
+
+
+static char const *const perf_names[PERF_COUNTERS] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+char const *
+perf_name(PERF_COUNTER c)
+{
+    return c < PERF_COUNTERS ? perf_names[c] : "unknown";
+}
+
+
+
+#ifdef OS_LINUX
+static unsigned long long const perf_configs[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+/* Grouped so the counters are scheduled together and read in one call;
+ * inherited so worker threads fold their counts in as they exit. Kernel
+ * and hypervisor time are left out, which lets unprivileged users open
+ * them. */
+static int
+perf_open_one_(unsigned long long config, int leader)
+{
+    struct perf_event_attr a;
+
+    memset(&a, 0, sizeof(a));
+    a.size           = sizeof(a);
+    a.type           = PERF_TYPE_HARDWARE;
+    a.config         = config;
+    a.disabled       = leader < 0;
+    a.inherit        = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv     = 1;
+    a.read_format    = PERF_FORMAT_GROUP;
+
+    return (int)syscall(__NR_perf_event_open, &a, 0, -1, leader, 0UL);
+}
+#endif
+
+bool
+perf_open(SELF)
+{
+    unsigned i;
+
+    if (!self) return false;
+
+    for (i = 0; i < PERF_COUNTERS; ++i) self->fd[i] = -1;
+    self->mask = 0U;
+
+#ifdef OS_LINUX
+    {
+        int leader = -1;
+
+        for (i = 0; i < PERF_COUNTERS; ++i)
+        {
+            self->fd[i] = perf_open_one_(perf_configs[i], leader);
+            if (self->fd[i] < 0)
+            {
+                VERBOSE_1
+                (
+                    fprintf(stderr, "WARNING: perf_open(%s) failed (%s).\n",
+                                    perf_names[i], strerror(errno));
+                )
+                continue;
+            }
+            if (leader < 0) leader = self->fd[i];
+            self->mask |= 1U << i;
+        }
+        if (leader >= 0)
+        {
+            ioctl(leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+#endif
+
+    if (!self->mask)
+    {
+        fprintf(stderr, "Hardware counters unavailable.\n");
+        return false;
+    }
+    return true;
+}
+
+void
+perf_close(SELF)
+{
+    unsigned i;
+
+    if (!self) return;
+
+#ifdef OS_LINUX
+    for (i = PERF_COUNTERS; i--;)
+    {
+        if (self->mask >> i & 1U) close(self->fd[i]);
+    }
+#endif
+    for (i = 0; i < PERF_COUNTERS; ++i) self->fd[i] = -1;
+    self->mask = 0U;
+}
+
+
+
+void
+perf_read(perf_group const *g, perf_counts *out)
+{
+    unsigned i;
+
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!perf_on(g)) return;
+
+#ifdef OS_LINUX
+    {
+        /* The leader (first open counter) gives the count of counters
+         * read, then each in the order it joined: ascending, skipping the
+         * ones that did not open */
+        unsigned long long buf[1 + PERF_COUNTERS];
+        size_t k = 1U, got;
+        ssize_t n;
+
+        for (i = 0; !(g->mask >> i & 1U); ++i);
+        n = read(g->fd[i], buf, sizeof(buf));
+        if (n < (ssize_t)sizeof(buf[0])) return;
+        got = (size_t)n / sizeof(buf[0]);
+        if (buf[0] + 1U < got) got = (size_t)buf[0] + 1U;
+
+        for (i = 0; i < PERF_COUNTERS && k < got; ++i)
+        {
+            if (g->mask >> i & 1U) out->v[i] = buf[k++];
+        }
+    }
+#else
+    (void)i;
+#endif
+}
+
+void
+perf_accum(perf_group const *g, perf_counts const *start, perf_counts *acc)
+{
+    perf_counts now;
+    unsigned i;
+
+    if (!perf_on(g) || !start || !acc) return;
+
+    perf_read(g, &now);
+    for (i = 0; i < PERF_COUNTERS; ++i) acc->v[i] += now.v[i] - start->v[i];
+}
+
+void
+perf_add(perf_counts *acc, perf_counts const *c)
+{
+    unsigned i;
+
+    for (i = 0; i < PERF_COUNTERS; ++i) acc->v[i] += c->v[i];
+}
+
+
+
+void
+perf_print(FILE *f, char const *label, perf_counts const *c, unsigned mask)
+{
+    unsigned i;
+
+    fprintf(f, "%-12s", label);
+    for (i = 0; i < PERF_COUNTERS; ++i)
+    {
+        if (mask >> i & 1U)
+            fprintf(f, " %s %llu", perf_names[i], c->v[i]);
+    }
+    if ((mask & 3U) == 3U && c->v[PERF_CYCLES])
+    {
+        fprintf(f, " ipc %.2f", (double)c->v[PERF_INSTRUCTIONS] /
+                                (double)c->v[PERF_CYCLES]);
+    }
+    fputc('\n', f);
+}
+
+void
+perf_json(FILE *f, perf_counts const *c, unsigned mask)
+{
+    unsigned i;
+    bool first = true;
+
+    fputc('{', f);
+    for (i = 0; i < PERF_COUNTERS; ++i)
+    {
+        if (!(mask >> i & 1U)) continue;
+        fprintf(f, "%s\"%s\": %llu", first ? "" : ", ", perf_names[i],
+                c->v[i]);
+        first = false;
+    }
+    fputc('}', f);
+}
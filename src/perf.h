@@ -0,0 +1,66 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Optional hardware performance counters read around build phases. Where
+    the counters cannot be opened every read gives zeros.
+*******************************************************************************/
+
+#ifndef PERF_H
+#define PERF_H
+
+#include "self.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define SELF perf_group *const self
+
+typedef enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS
+} PERF_COUNTER;
+
+typedef struct {
+    unsigned long long v[PERF_COUNTERS];
+} perf_counts;
+
+/* Counters of the opening thread and the threads it starts afterwards */
+typedef struct {
+    int      fd[PERF_COUNTERS]; /* -1 where not open */
+    unsigned mask;              /* Bit per open counter, 0 = off */
+} perf_group;
+
+
+
+static inline bool
+perf_on(perf_group const *g)
+{
+    return g && g->mask;
+}
+
+/* Opens what counters it can, false when none */
+bool perf_open (SELF);
+void perf_close(SELF);
+
+void perf_read(perf_group const *g, perf_counts *out);
+
+/* Adds the counts since start to acc */
+void perf_accum(perf_group const *g, perf_counts const *start,
+                perf_counts *acc);
+
+void perf_add(perf_counts *acc, perf_counts const *c);
+
+char const *perf_name(PERF_COUNTER c);
+
+/* One line, or a JSON object, of the counters open in mask */
+void perf_print(FILE *f, char const *label, perf_counts const *c,
+                unsigned mask);
+void perf_json (FILE *f, perf_counts const *c, unsigned mask);
+
+#undef SELF
+#endif /* PERF_H */
@@ -9,22 +9,200 @@
 
 #include "pools.h"
 #include "math.h"
+#include "mem.h"
+#include "thread.h"
+#include "timer.h"
 #include "verbose.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef OS_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#elif defined(OS_LINUX)
+#include <sys/mman.h>
+#endif
+
 #define SELF pools *const self
 
+#define POOLS_PLANES_SERIAL 65536 /* Faces below which threads cost more */
+#define POOLS_ARENA_CHUNK  (2U<<20) /* Commit granule: one huge page */
+#define POOLS_ARENA_VERTS  0xFFFFU
+
+
+
+/* Releases a pool array, whether heap or file mapping */
+static void
+pools_release_(void *p, size_t mapped)
+{
+    if (!mapped)
+    {
+        free(p);
+        return;
+    }
+#ifdef OS_WINDOWS
+    UnmapViewOfFile(p);
+#elif defined(OS_LINUX)
+    munmap(p, mapped);
+#endif
+}
+
+/* Moves a pool array mapped over `mapped` bytes to the heap, keeping the
+ * first `keep` bytes. Returns the heap copy (NULL if out of memory, the
+ * mapping is then left alone). */
+static void *
+pools_unmap_(void *p, size_t mapped, size_t keep)
+{
+    void *heap = malloc(keep ? keep : 1U);
+
+    if (!heap) return NULL;
+    memcpy(heap, p, keep < mapped ? keep : mapped);
+    pools_release_(p, mapped);
+    return heap;
+}
+
+static size_t
+pools_chunks_(size_t bytes)
+{
+    return (bytes + POOLS_ARENA_CHUNK-1) / POOLS_ARENA_CHUNK * POOLS_ARENA_CHUNK;
+}
+
+/* Reserves address space only: nothing is committed */
+static void *
+pools_vm_reserve_(size_t bytes, bool huge)
+{
+    void *p;
+
+#ifdef OS_WINDOWS
+    /* Large pages cannot be committed piecemeal: huge is ignored */
+    (void)huge;
+    p = VirtualAlloc(NULL, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#elif defined(OS_LINUX)
+    p = mmap(NULL, bytes, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(p, bytes, MADV_HUGEPAGE);
+#else
+    (void)huge;
+#endif
+#endif
+    return p;
+}
+
+/* Commits the chunks covering bytes [from, to) of a reservation. Fresh
+ * pages arrive zeroed from the system. */
+static bool
+pools_vm_commit_(void *base, size_t from, size_t to)
+{
+    char *p = base;
+
+    from = from / POOLS_ARENA_CHUNK * POOLS_ARENA_CHUNK;
+    to   = pools_chunks_(to);
+    if (from >= to) return true;
+#ifdef OS_WINDOWS
+    return VirtualAlloc(p + from, to - from, MEM_COMMIT, PAGE_READWRITE)
+           != NULL;
+#elif defined(OS_LINUX)
+    return !mprotect(p + from, to - from, PROT_READ | PROT_WRITE);
+#endif
+}
+
+static void
+pools_vm_release_(void *p, size_t bytes)
+{
+    if (!p) return;
+#ifdef OS_WINDOWS
+    (void)bytes;
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(OS_LINUX)
+    munmap(p, pools_chunks_(bytes));
+#endif
+}
+
+/* Accounts for capacity changed from verts and faces (mem.h) */
+static void
+pools_account_(SELF, size_t verts, size_t faces)
+{
+    mem_track(MEM_VERTS,  verts * sizeof(vert),  self->c_verts * sizeof(vert));
+    mem_track(MEM_FACES,  faces * sizeof(face),  self->c_faces * sizeof(face));
+    mem_track(MEM_PLANES, faces * sizeof(plane),
+                          self->c_faces * sizeof(plane));
+}
+
+
 
 void
 pools_free(SELF)
 {
-    free(self->verts);
-    free(self->faces);
-    free(self->planes);
+    size_t const verts = self->c_verts, faces = self->c_faces;
+
+    if (self->r_faces)
+    {
+        pools_vm_release_(self->verts, self->r_verts * sizeof(vert));
+        pools_vm_release_(self->faces, self->r_faces * sizeof(face));
+        pools_vm_release_(self->planes, self->r_faces * sizeof(plane));
+    }
+    else
+    {
+        pools_release_(self->verts, self->m_verts);
+        pools_release_(self->faces, self->m_faces);
+        pools_release_(self->planes, self->m_planes);
+    }
     pools_init(self);
+    pools_account_(self, verts, faces);
+}
+
+bool
+pools_arena(SELF, size_t max_faces, bool huge)
+{
+    vert  *v;
+    face  *f;
+    plane *p;
+
+    if (!self || self->r_faces) return false;
+    if (!max_faces) max_faces = POOLS_ARENA_FACES;
+    if (max_faces < self->c_faces) max_faces = self->c_faces;
+
+    v = pools_vm_reserve_(pools_chunks_(POOLS_ARENA_VERTS * sizeof(vert)),
+                          huge);
+    f = pools_vm_reserve_(pools_chunks_(max_faces * sizeof(face)), huge);
+    p = pools_vm_reserve_(pools_chunks_(max_faces * sizeof(plane)), huge);
+
+    if (!v || !f || !p ||
+        !pools_vm_commit_(v, 0U, self->c_verts * sizeof(vert)) ||
+        !pools_vm_commit_(f, 0U, self->c_faces * sizeof(face)) ||
+        !pools_vm_commit_(p, 0U, self->c_faces * sizeof(plane)))
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "ERROR: pools_arena(%zu faces) reservation.\n",
+                            max_faces);
+        )
+        pools_vm_release_(v, POOLS_ARENA_VERTS * sizeof(vert));
+        pools_vm_release_(f, max_faces * sizeof(face));
+        pools_vm_release_(p, max_faces * sizeof(plane));
+        return false;
+    }
+
+    if (self->verts)  memcpy(v, self->verts,  self->c_verts * sizeof(vert));
+    if (self->faces)  memcpy(f, self->faces,  self->c_faces * sizeof(face));
+    if (self->planes) memcpy(p, self->planes, self->c_faces * sizeof(plane));
+
+    pools_release_(self->verts, self->m_verts);
+    pools_release_(self->faces, self->m_faces);
+    pools_release_(self->planes, self->m_planes);
+    self->verts   = v;
+    self->faces   = f;
+    self->planes  = p;
+    self->m_verts = self->m_faces = self->m_planes = 0U;
+    self->r_verts = POOLS_ARENA_VERTS;
+    self->r_faces = max_faces;
+    return true;
 }
 
 bool
@@ -46,6 +224,69 @@ pools_alloc(SELF, size_t verts, size_t faces)
 
     self->n_verts = self->c_verts = verts;
     self->n_faces = self->c_faces = faces;
+    pools_account_(self, 0U, 0U);
+    return true;
+}
+
+bool
+pools_alloc_raw(SELF, size_t verts, size_t faces)
+{
+    if (!self) return false;
+
+    pools_free(self);
+
+    self->verts  = malloc((verts ? verts : 1U) * sizeof(vert));
+    self->faces  = malloc((faces ? faces : 1U) * sizeof(face));
+    self->planes = malloc((faces ? faces : 1U) * sizeof(plane));
+
+    if (!self->verts || !self->faces || !self->planes)
+    {
+        pools_free(self);
+        return false;
+    }
+
+    self->n_verts = self->c_verts = verts;
+    self->n_faces = self->c_faces = faces;
+    pools_account_(self, 0U, 0U);
+    return true;
+}
+
+bool
+pools_alloc_mapped(SELF, vert *verts, size_t vm, face *faces, size_t fm)
+{
+    if (!self || !verts || !faces || !vm || !fm) return false;
+
+    pools_free(self);
+
+    /* Every plane is written by pools_make_planes: no need to clear them */
+    self->planes = malloc((fm / sizeof(face)) * sizeof(plane));
+    if (!self->planes) return false;
+
+    self->verts   = verts;
+    self->faces   = faces;
+    self->m_verts = vm;
+    self->m_faces = fm;
+    self->n_verts = self->c_verts = vm / sizeof(vert);
+    self->n_faces = self->c_faces = fm / sizeof(face);
+    pools_account_(self, 0U, 0U);
+    return true;
+}
+
+bool
+pools_map_planes(SELF, plane *planes, size_t pm, size_t n)
+{
+    size_t faces;
+
+    if (!self || !planes || self->r_faces || n > self->n_faces ||
+        n*sizeof(plane) > pm)
+        return false;
+
+    faces = self->c_faces;
+    pools_release_(self->planes, self->m_planes);
+    self->planes   = planes;
+    self->m_planes = pm;
+    self->n_faces  = self->c_faces = n;
+    pools_account_(self, self->c_verts, faces);
     return true;
 }
 
@@ -56,21 +297,27 @@ pools_realloc_faces_(SELF, size_t cap)
     face  *n_f;
     plane *n_p;
 
+    old = self->c_faces;
     if (!cap)
     {
         VERBOSE_2
         (
             fprintf(stderr, "WARNING: pools_realloc_faces(cap = 0)\n");
         )
-        free(self->faces);
-        free(self->planes);
-        self->faces   = NULL;
-        self->planes  = NULL;
+        if (!self->r_faces)
+        {
+            pools_release_(self->faces, self->m_faces);
+            pools_release_(self->planes, self->m_planes);
+            self->faces    = NULL;
+            self->planes   = NULL;
+            self->m_faces  = 0U;
+            self->m_planes = 0U;
+        }
         self->n_faces = 0U;
         self->c_faces = 0U;
+        pools_account_(self, self->c_verts, old);
         return true;
     }
-    old = self->c_faces;
     if (cap == old)
     {
         VERBOSE_2
@@ -82,6 +329,59 @@ pools_realloc_faces_(SELF, size_t cap)
     if (cap  > old)
         init = cap - old;
 
+    /* Arena: commit in place. Slots past a shrink keep their contents. */
+    if (self->r_faces)
+    {
+        if (cap > self->r_faces ||
+            !pools_vm_commit_(self->faces, old*sizeof(face),
+                              cap*sizeof(face)) ||
+            !pools_vm_commit_(self->planes, old*sizeof(plane),
+                              cap*sizeof(plane)))
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "ERROR: pools_realloc_faces(%zu faces) past "
+                                "arena.\n", cap);
+            )
+            return false;
+        }
+        self->c_faces = cap;
+        if (self->n_faces > cap) self->n_faces = cap;
+        pools_account_(self, self->c_verts, old);
+        return true;
+    }
+
+    /* A file mapping cannot be resized: move it to the heap first */
+    if (self->m_faces)
+    {
+        face *heap = pools_unmap_(self->faces, self->m_faces, old*sizeof(face));
+        if (!heap)
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "ERROR (OOM): pools_realloc_faces(unmap)\n");
+            )
+            return false;
+        }
+        self->faces = heap;
+        self->m_faces = 0U;
+    }
+    if (self->m_planes)
+    {
+        plane *heap = pools_unmap_(self->planes, self->m_planes,
+                                   old*sizeof(plane));
+        if (!heap)
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "ERROR (OOM): pools_realloc_faces(unmap)\n");
+            )
+            return false;
+        }
+        self->planes = heap;
+        self->m_planes = 0U;
+    }
+
     n_f = realloc(self->faces, cap*sizeof(face));
     if (!n_f)
     {
@@ -110,6 +410,7 @@ pools_realloc_faces_(SELF, size_t cap)
     memset(n_p + old, 0, init*sizeof(plane));
     self->planes  = n_p;
     self->c_faces = cap;
+    pools_account_(self, self->c_verts, old);
 
     if (!init && self->n_faces > cap)
     {
@@ -139,19 +440,24 @@ pools_realloc_verts_(SELF, size_t cap)
     size_t init = 0U, old;
     vert *nmem;
 
+    old = self->c_verts;
     if (!cap)
     {
         VERBOSE_2
         (
             fprintf(stderr, "WARNING: pools_realloc_verts(cap = 0)\n");
         )
-        free(self->verts);
-        self->verts = NULL;
+        if (!self->r_verts)
+        {
+            pools_release_(self->verts, self->m_verts);
+            self->verts = NULL;
+            self->m_verts = 0U;
+        }
         self->n_verts = 0U;
         self->c_verts = 0U;
+        pools_account_(self, old, self->c_faces);
         return true;
     }
-    old = self->c_verts;
     if (cap == old)
     {
         VERBOSE_2
@@ -163,6 +469,40 @@ pools_realloc_verts_(SELF, size_t cap)
     if (cap  > old)
         init = cap - old;
 
+    if (self->r_verts)
+    {
+        if (cap > self->r_verts ||
+            !pools_vm_commit_(self->verts, old*sizeof(vert), cap*sizeof(vert)))
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "ERROR: pools_realloc_verts(%zu verts) past "
+                                "arena.\n", cap);
+            )
+            return false;
+        }
+        self->c_verts = cap;
+        if (self->n_verts > cap) self->n_verts = cap;
+        pools_account_(self, old, self->c_faces);
+        return true;
+    }
+
+    /* A file mapping cannot be resized: move it to the heap first */
+    if (self->m_verts)
+    {
+        vert *heap = pools_unmap_(self->verts, self->m_verts, old*sizeof(vert));
+        if (!heap)
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "ERROR (OOM): pools_realloc_verts(unmap)\n");
+            )
+            return false;
+        }
+        self->verts = heap;
+        self->m_verts = 0U;
+    }
+
     nmem = realloc(self->verts, cap*sizeof(vert));
     if (!nmem)
     {
@@ -177,6 +517,7 @@ pools_realloc_verts_(SELF, size_t cap)
     memset(nmem + old, 0, init*sizeof(vert));
     self->verts = nmem;
     self->c_verts = cap;
+    pools_account_(self, old, self->c_faces);
 
     if (!init && self->n_verts > cap)
     {
@@ -220,37 +561,93 @@ pools_realloc_verts(SELF, size_t cap)
 }
 
 bool
-pools_expand_verts(SELF)
+pools_shrink(SELF)
+{
+    if (!self) return false;
+    if (self->r_faces || self->m_verts || self->m_faces || self->m_planes)
+        return true;
+
+    return (!self->n_verts || self->n_verts == self->c_verts ||
+            pools_realloc_verts_(self, self->n_verts)) &&
+           (!self->n_faces || self->n_faces == self->c_faces ||
+            pools_realloc_faces_(self, self->n_faces));
+}
+
+/* Grows a pool in one step to hold `need` elements, at least doubling so
+ * that repeated growth stays amortised O(1) */
+static bool
+pools_grow_verts_(SELF, size_t need)
 {
     size_t cap;
+    double t0;
+    bool ok;
 
-    if (!self)
+    if (need <= self->c_verts) return true;
+    if (need > 0xFFFF)
     {
         VERBOSE_2
         (
-            fprintf(stderr, "Call to expand vertex pool without SELF.\n");
+            fprintf(stderr, "Call to expand vertex pool exceeds limit.\n");
         )
         return false;
     }
 
-    cap = self->c_verts;
-    if (cap >= 0xFFFF)
+    cap = self->c_verts<<1;
+    if (cap < need)   cap = need;
+    if (cap > 0xFFFF) cap = 0xFFFF;
+    t0 = timer_now();
+    ok = pools_realloc_verts_(self, cap);
+    mem_grew(timer_now() - t0);
+    return ok;
+}
+
+static bool
+pools_grow_faces_(SELF, size_t need)
+{
+    size_t cap;
+    double t0;
+    bool ok;
+
+    if (need <= self->c_faces) return true;
+
+    cap = self->c_faces<<1;
+    if (cap < need) cap = need;
+    t0 = timer_now();
+    ok = pools_realloc_faces_(self, cap);
+    mem_grew(timer_now() - t0);
+    return ok;
+}
+
+bool
+pools_expand_verts(SELF)
+{
+    if (!self)
     {
         VERBOSE_2
         (
-            fprintf(stderr, "Call to expand vertex pool exceeds limit.\n");
+            fprintf(stderr, "Call to expand vertex pool without SELF.\n");
         )
         return false;
     }
-
-    cap = (cap<<1) > 0xFFFF ? 0xFFFF : (cap<<1); 
-    return pools_realloc_verts_(self, cap);
+    return pools_grow_verts_(self, self->c_verts + 1U);
 }
 
 bool
 pools_expand_faces(SELF)
 {
-    return self ? pools_realloc_faces_(self, self->c_faces<<1) : false;
+    return self ? pools_grow_faces_(self, self->c_faces + 1U) : false;
+}
+
+bool
+pools_reserve(SELF, size_t verts, size_t faces)
+{
+    if (!self)
+    {
+        VERBOSE_2(fprintf(stderr, "WARNING: pools_reserve(self = NULL)\n");)
+        return false;
+    }
+    return pools_grow_verts_(self, self->n_verts + verts) &&
+           pools_grow_faces_(self, self->n_faces + faces);
 }
 
 unsigned short
@@ -357,12 +754,7 @@ pools_vert_declare(SELF, size_t num)
         VERBOSE_2(fprintf(stderr, "WARNING: pools_vert_declare(self = NULL)\n");)
         return false;
     }
-    if (self->n_verts + num >= self->c_verts &&
-        !pools_expand_verts(self))
-    {
-        return false;
-    }
-    return true;
+    return pools_grow_verts_(self, self->n_verts + num);
 }
 
 bool
@@ -373,12 +765,7 @@ pools_face_declare(SELF, size_t num)
         VERBOSE_2(fprintf(stderr, "WARNING: pools_face_declare(self = NULL)\n");)
         return false;
     }
-    if (self->n_faces + num >= self->c_faces &&
-        !pools_expand_faces(self))
-    {
-        return false;
-    }
-    return true;
+    return pools_grow_faces_(self, self->n_faces + num);
 }
 
 unsigned short
@@ -484,6 +871,7 @@ bool
 pools_face_decl_insert(SELF, face *f, plane *p, unsigned short pos)
 {
     size_t nf, i;
+    plane  pc;
 
     if (!self)
     {
@@ -539,6 +927,9 @@ pools_face_decl_insert(SELF, face *f, plane *p, unsigned short pos)
 
     nf = self->n_faces++;
 
+    /* p may point into the pool (e.g. the plane of a face being clipped) */
+    if (p) pc = *p;
+
     /* Move elements to the right */
     for (i = nf; i > pos; --i)
         self->faces[i] = self->faces[i-1];
@@ -550,7 +941,7 @@ pools_face_decl_insert(SELF, face *f, plane *p, unsigned short pos)
     if (!p) {
         plane_from_face(self->planes + pos, self->verts, f);
     } else {
-        self->planes[pos] = *p;
+        self->planes[pos] = pc;
     }
 
     VERBOSE_3
@@ -631,6 +1022,7 @@ bool
 pools_face_insert(SELF, face *f, plane *p, unsigned short pos)
 {
     size_t nf, i;
+    plane  pc;
 
     if (!self)
     {
@@ -687,6 +1079,9 @@ pools_face_insert(SELF, face *f, plane *p, unsigned short pos)
 
     nf = self->n_faces++;
 
+    /* p may point into the pool (e.g. the plane of a face being clipped) */
+    if (p) pc = *p;
+
     /* Move elements to the right */
     for (i = nf; i > pos; --i)
         self->faces[i] = self->faces[i-1];
@@ -698,7 +1093,7 @@ pools_face_insert(SELF, face *f, plane *p, unsigned short pos)
     if (!p) {
         plane_from_face(self->planes + pos, self->verts, f);
     } else {
-        self->planes[pos] = *p;
+        self->planes[pos] = pc;
     }
 
     VERBOSE_3
@@ -708,11 +1103,49 @@ pools_face_insert(SELF, face *f, plane *p, unsigned short pos)
     return true;
 }
 
+/* Appends a rejected face ID to an optional report */
+static bool
+pools_reject_(pools_rejects *rej, size_t id)
+{
+    size_t *n_ids, cap;
+
+    if (!rej) return true;
+    if (rej->n == rej->cap)
+    {
+        cap   = rej->cap ? rej->cap * 2U : 64U;
+        n_ids = realloc(rej->ids, cap * sizeof(*n_ids));
+        if (!n_ids)
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "ERROR (OOM): pools_reject(%zu ids)\n", cap);
+            )
+            return false;
+        }
+        mem_track(MEM_SCRATCH, rej->cap * sizeof(*n_ids), cap * sizeof(*n_ids));
+        rej->ids = n_ids;
+        rej->cap = cap;
+    }
+    rej->ids[rej->n++] = id;
+    return true;
+}
+
+void
+pools_rejects_free(pools_rejects *rej)
+{
+    if (!rej) return;
+    mem_track(MEM_SCRATCH, rej->cap * sizeof(*rej->ids), 0U);
+    free(rej->ids);
+    rej->ids = NULL;
+    rej->n = rej->cap = 0U;
+}
+
 bool
-pools_check(SELF)
+pools_check(SELF, pools_rejects *rej)
 {
-    size_t i, j, nv;
+    size_t i, w, nv;
     face *faces;
+    bool ok = true;
 
     if (!self ||
         !self->verts   || !self->faces || !self->planes ||
@@ -726,22 +1159,32 @@ pools_check(SELF)
 
     fprintf(stderr, "Num verts: %zu.\nNum faces: %zu.\n", nv, self->n_faces);
 
-    for (i = 0, j = self->n_faces;      i < j;      ++i)
+    /* Stable compaction: kept faces slide down over the rejected ones */
+    for (i = 0, w = 0; i < self->n_faces; ++i)
     {
         if (faces[i].i[0] >= nv ||
             faces[i].i[1] >= nv ||
             faces[i].i[2] >= nv)
         {
-            fprintf(stderr,
-                    "Face %zu contains an index that exceeds the vertex pool "
-                    "and will be deleted.\n", i);
-
-            pools_face_del(self, i, PF_DEL_FACE);
-            --i; --j;
+            VERBOSE_3
+            (
+                fprintf(stderr,
+                        "Face %zu contains an index that exceeds the vertex "
+                        "pool and will be deleted.\n", i);
+            )
+            ok &= pools_reject_(rej, i);
+            continue;
         }
+        faces[w++] = faces[i];
     }
 
-    return true;
+    if (w != self->n_faces)
+    {
+        fprintf(stderr, "%zu faces contain an index that exceeds the vertex "
+                        "pool and were deleted.\n", self->n_faces - w);
+    }
+    self->n_faces = w;
+    return ok;
 }
 
 bool
@@ -779,10 +1222,27 @@ pools_face_del(SELF, size_t f, POOL_FLAGS pf)
     return true;
 }
 
+typedef struct {
+    pools         *pool;
+    unsigned char *ok;
+} pools_planes_job;
+
+static void
+pools_planes_slice(void *arg, size_t begin, size_t end)
+{
+    pools_planes_job const *job = arg;
+    pools *const pool = job->pool;
+
+    plane_from_faces(pool->planes + begin, job->ok + begin,
+                     pool->verts, pool->faces + begin, end - begin);
+}
+
 bool
-pools_make_planes(SELF)
+pools_make_planes(SELF, pools_rejects *rej)
 {
-    size_t i, j;
+    pools_planes_job job;
+    size_t i, w;
+    bool ok = true;
 
     if (!self ||
         !self->verts   || !self->faces || !self->planes ||
@@ -791,31 +1251,216 @@ pools_make_planes(SELF)
         return false;
     }
 
-    for (i = 0, j = self->n_faces;      i < j;      ++i)
+    /* Batched planes over every processor, then a stable compaction as in
+     * pools_check */
+    job.pool = self;
+    job.ok   = malloc(self->n_faces);
+    if (!job.ok)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "ERROR (OOM): pools_make_planes(%zu faces)\n",
+                            self->n_faces);
+        )
+        return false;
+    }
+    mem_track(MEM_SCRATCH, 0U, self->n_faces);
+    thread_for(pools_planes_slice, &job, self->n_faces,
+               self->n_faces < POOLS_PLANES_SERIAL ? 1U : 0U);
+
+    for (i = 0, w = 0; i < self->n_faces; ++i)
     {
-        if (!plane_from_face(self->planes+i,
-                             self->verts,
-                             self->faces+i))
+        if (!job.ok[i])
         {
-            fprintf(stderr,
-                    "Face %zu does not form a plane and will be deleted.\n",
-                    i);
+            VERBOSE_3
+            (
+                fprintf(stderr,
+                        "Face %zu does not form a plane and will be "
+                        "deleted.\n", i);
+            )
+            ok &= pools_reject_(rej, i);
+            continue;
+        }
+        self->planes[w]  = self->planes[i];
+        self->faces[w++] = self->faces[i];
+    }
+    free(job.ok);
+    mem_track(MEM_SCRATCH, self->n_faces, 0U);
 
-            pools_face_del(self, i, PF_DEL_FACE);
-            --i; --j;
+    if (w != self->n_faces)
+    {
+        fprintf(stderr, "%zu faces do not form a plane and were deleted.\n",
+                self->n_faces - w);
+    }
+    self->n_faces = w;
+    return ok;
+}
+
+
+/* Cell of a coordinate on the weld grid (floor without the libm call).
+ * Exact welds (inv = 0) key on the value itself, with -0 taken as 0. */
+static inline long long
+pools_weld_cell(float x, float inv)
+{
+    double const t = (double)x * inv;
+    long long c;
+
+    if (!(inv > 0.0f))
+    {
+        unsigned int b;
+
+        x += 0.0f;
+        memcpy(&b, &x, sizeof(b));
+        return (long long)b;
+    }
+
+    if (!(t > -4e18)) return (long long)-4e18;
+    if (!(t <  4e18)) return (long long) 4e18;
+    c = (long long)t;
+    return c - (t < (double)c);
+}
+
+static inline size_t
+pools_weld_hash(long long x, long long y, long long z, size_t mask)
+{
+    unsigned long long h = (unsigned long long)x * 0x9E3779B97F4A7C15ULL ^
+                           (unsigned long long)y * 0xC2B2AE3D27D4EB4FULL ^
+                           (unsigned long long)z * 0x165667B19E3779F9ULL;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    return (size_t)(h ^ (h >> 32)) & mask;
+}
+
+bool
+pools_weld(SELF, float tol, bool *moved)
+{
+    /* Indices are 16 bit, with 0xFFFF never valid: chains, marks and maps
+     * all fit in 16 bits, which keeps the table in cache */
+    unsigned short const none = 0xFFFF;
+    unsigned short *head = NULL, *next = NULL, *map = NULL, found;
+    size_t i, j, k, n, cap, was;
+    double const t0 = timer_now();
+    float const inv = tol > 0.0f ? 0.5f / tol : 0.0f, tol2 = tol * tol;
+    long long lo[3], hi[3], x, y, z;
+
+    if (moved) *moved = false;
+    if (!self || !self->verts || !self->faces || !self->planes ||
+        !(tol >= 0.0f)) return false;
+
+    was = self->n_verts;
+    n   = was < none ? was : none;
+    for (cap = 16U; cap < 2U*n; cap <<= 1);
+
+    head = malloc(cap * sizeof(*head));
+    next = malloc((n ? n : 1U) * sizeof(*next));
+    map  = malloc((n ? n : 1U) * sizeof(*map));
+    if (!head || !next || !map)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "ERROR (OOM): pools_weld(%zu verts)\n", n);
+        )
+        free(head);
+        free(next);
+        free(map);
+        return false;
+    }
+    mem_track(MEM_SCRATCH, 0U, (cap + 2U*n) * sizeof(*head));
+    memset(head, 0xFF, cap * sizeof(*head));
+    memset(map,  0xFF, n   * sizeof(*map));
+
+    /* Only referenced vertices survive */
+    for (i = 0; i < self->n_faces; ++i)
+    for (k = 0; k < 3; ++k)
+        if (self->faces[i].i[k] < n) map[self->faces[i].i[k]] = 0U;
+
+    /* Each vertex joins the first kept one within tol, or is kept itself.
+     * Cells are 2 tol wide, so only those its tol box touches (usually its
+     * own, at most 8) need searching. */
+    for (i = 0; i < n; ++i)
+    {
+        vert const *v = self->verts + i;
+
+        if (map[i] == none) continue;
+
+        for (k = 0; k < 3; ++k)
+        {
+            lo[k] = pools_weld_cell(v->m[k] - tol, inv);
+            hi[k] = pools_weld_cell(v->m[k] + tol, inv);
         }
-#if 0
-        else
+
+        found = none;
+        for (x = lo[0]; x <= hi[0] && found == none; ++x)
+        for (y = lo[1]; y <= hi[1] && found == none; ++y)
+        for (z = lo[2]; z <= hi[2] && found == none; ++z)
+        for (j = head[pools_weld_hash(x, y, z, cap-1U)]; j != none; j = next[j])
         {
-            plane *ptr = self->planes+i;
+            vert const *w = self->verts + j;
+            float const d[3] = { v->x - w->x, v->y - w->y, v->z - w->z };
+
+            if (d[0]*d[0] + d[1]*d[1] + d[2]*d[2] <= tol2 &&
+                (tol > 0.0f || (d[0] == 0.0f && d[1] == 0.0f && d[2] == 0.0f)))
+            {
+                found = (unsigned short)j;
+                if (moved && (d[0] != 0.0f || d[1] != 0.0f || d[2] != 0.0f))
+                    *moved = true;
+                break;
+            }
+        }
 
-            printf("{d = % 8.2f, % 1.4f, % 1.4f, % 1.4f}\n",
-                   ptr->d, ptr->x, ptr->y, ptr->z);
+        if (found != none)
+        {
+            map[i] = found;
+            continue;
         }
-#endif
+        map[i] = (unsigned short)i;
+        j = pools_weld_hash(pools_weld_cell(v->x, inv),
+                            pools_weld_cell(v->y, inv),
+                            pools_weld_cell(v->z, inv), cap-1U);
+        next[i] = head[j];
+        head[j] = (unsigned short)i;
     }
 
-    return true;
-}
+    /* Compact kept vertices in order (a new index never passes its old
+     * one), then point every vertex at its keeper's new index. Keepers
+     * come first, so theirs is already final when a welded one looks. */
+    for (i = 0, k = 0; i < n; ++i)
+    {
+        if (map[i] == i)
+        {
+            self->verts[k] = self->verts[i];
+            map[i] = (unsigned short)k++;
+        }
+        else if (map[i] != none)
+        {
+            map[i] = map[map[i]];
+        }
+    }
+    self->n_verts = k;
 
+    /* Remap faces, dropping those welded flat. Bad indices stay bad. */
+    for (i = 0, j = 0; i < self->n_faces; ++i)
+    {
+        face f = self->faces[i];
 
+        for (k = 0; k < 3; ++k)
+            f.i[k] = f.i[k] < n ? map[f.i[k]] : none;
+
+        if (f.i[0] != none && f.i[1] != none && f.i[2] != none &&
+            (f.i[0] == f.i[1] || f.i[1] == f.i[2] || f.i[2] == f.i[0]))
+            continue;
+
+        self->planes[j]  = self->planes[i];
+        self->faces[j++] = f;
+    }
+
+    fprintf(stderr, "Welded %zu verts to %zu (%zu faces to %zu) in %.3f ms.\n",
+            was, self->n_verts, self->n_faces, j, (timer_now() - t0) * 1e3);
+    self->n_faces = j;
+
+    free(head);
+    free(next);
+    free(map);
+    mem_track(MEM_SCRATCH, (cap + 2U*n) * sizeof(*head), 0U);
+    return true;
+}
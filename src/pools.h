@@ -20,17 +20,27 @@
 
 #define SELF pools *const self
 
+#define POOLS_ARENA_FACES 0xFFFFU /* Default arena: all a bsp_node can index */
+
 typedef enum {
     PF_DEL_FACE = 1,
     PF_DEL_PLANE = 2,
 } POOL_FLAGS;
 
+/* Faces rejected by a pass, by their ID as it was on entry (ascending) */
+typedef struct {
+    size_t  n, cap;
+    size_t *ids;
+} pools_rejects;
+
 typedef struct {
     size_t n_verts, n_faces, /* Number */
            c_verts, c_faces; /* Capacity */
     vert  *verts;
     face  *faces;
     plane *planes;
+    size_t m_verts, m_faces, m_planes; /* Bytes mapped from file (0 = heap) */
+    size_t r_verts, r_faces;           /* Arena reservation (0 = heap) */
 } pools;
 
 
@@ -45,15 +55,47 @@ pools_init(SELF)
     self->verts   = NULL;
     self->faces   = NULL;
     self->planes  = NULL;
+    self->m_verts = self->m_faces = self->m_planes = 0U;
+    self->r_verts = self->r_faces = 0U;
 }
 
-bool pools_alloc(SELF, size_t verts, size_t faces);
+bool pools_alloc    (SELF, size_t verts, size_t faces);
+bool pools_alloc_raw(SELF, size_t verts, size_t faces); /* Not cleared */
+
+/* Adopts copy-on-write file mappings of vm and fm bytes as the vertex and
+ * face pools. Planes are allocated but not cleared. The pools unmap them,
+ * copying out first when they need to grow. */
+bool pools_alloc_mapped(SELF, vert *verts, size_t vm, face *faces, size_t fm);
+
+/* Adopts a copy-on-write mapping of pm bytes holding the planes of the
+ * first n faces, which become all the faces */
+bool pools_map_planes(SELF, plane *planes, size_t pm, size_t n);
+
 void pools_free (SELF);
-bool pools_check(SELF);
+
+/* Moves the pools into address space reserved for max_faces faces (0 for
+ * POOLS_ARENA_FACES) and the full 16 bit vertex range. Growth then commits
+ * further chunks in place: no copy, no clearing, and pointers into the
+ * pools stay valid. huge asks for transparent huge pages where offered. */
+bool pools_arena(SELF, size_t max_faces, bool huge);
+
+/* Cuts capacity to the verts and faces in use, e.g. once a build is done.
+ * Arena and mapped pools are left as they are. */
+bool pools_shrink(SELF);
+
+/* Delete faces with an index past the vertex pool (check) or that form no
+ * plane (make_planes) in one stable pass, appending their IDs to rej when
+ * given. Release rej with pools_rejects_free. */
+bool pools_check      (SELF, pools_rejects *rej);
+bool pools_make_planes(SELF, pools_rejects *rej);
+void pools_rejects_free(pools_rejects *rej);
 
 bool pools_vert_declare(SELF, size_t num); /* Declare num verts will be added */
 bool pools_face_declare(SELF, size_t num); /* Declare num faces will be added */
 
+/* Room for verts and faces more, each pool growing at most once */
+bool pools_reserve(SELF, size_t verts, size_t faces);
+
 unsigned short pools_vert_add  (SELF, vert *v);
 unsigned short pools_vert_add_f(SELF, float *v);
 
@@ -68,7 +110,11 @@ bool pools_face_insert(SELF, face *f, plane *p,
 
 bool pools_face_del(SELF, size_t f, POOL_FLAGS);
 
-bool pools_make_planes(SELF);
+/* Merges vertices within tol of each other (0 = exact duplicates only),
+ * drops those no face uses and faces left with a repeated corner. Planes
+ * of kept faces move with them; *moved (optional) is set if a vertex was
+ * merged into one at another position, which leaves them stale. */
+bool pools_weld(SELF, float tol, bool *moved);
 
 #undef SELF
 #endif /* POOLS_H */
@@ -0,0 +1,267 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Measures a finished tree by what it costs at query time: shape, splits,
+    and the nodes point and ray queries visit on average.
+*******************************************************************************/
+
+#include "quality.h"
+#include "math.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define QUALITY_SEED 0x5EEDU
+
+
+
+typedef struct {
+    bsp_ind  id;
+    unsigned depth;
+} quality_visit;
+
+typedef struct {
+    bsp_ind id;
+    float   a[3], b[3];
+} quality_span;
+
+static void
+quality_point(bsp_box const *box, unsigned *s, float *out)
+{
+    unsigned k;
+
+    for (k = 0; k < 3; ++k)
+    {
+        out[k] = box->min[k] + (box->max[k] - box->min[k]) * math_rand(s);
+    }
+}
+
+static unsigned
+quality_bucket(size_t n)
+{
+    unsigned b;
+
+    for (b = 0; b+1 < QUALITY_BUCKETS && n >> (b+1); ++b);
+    return b;
+}
+
+
+
+/* Depths and coplanar buckets, walking from the root */
+static bool
+quality_shape(bsp const *tree, quality *q, quality_visit *stack)
+{
+    size_t n = 0U, depth_sum = 0U, coplanar_sum = 0U;
+
+    stack[n].id    = 0;
+    stack[n].depth = 1U;
+    ++n;
+
+    while (n)
+    {
+        quality_visit const v = stack[--n];
+        bsp_node const *nd;
+        size_t cop;
+
+        if (v.id >= tree->occ) return false;
+        nd = tree->d + v.id;
+
+        ++q->nodes;
+        cop = (size_t)nd->pr - nd->pl + 1U;
+        coplanar_sum += cop;
+        if (cop > q->coplanar_max) q->coplanar_max = cop;
+        ++q->coplanar_hist[quality_bucket(cop)];
+
+        if (v.depth > q->depth_max) q->depth_max = v.depth;
+        if (nd->l == 0xFFFF && nd->r == 0xFFFF)
+        {
+            ++q->leaves;
+            depth_sum += v.depth;
+            ++q->depth_hist[v.depth <= QUALITY_DEPTH ? v.depth-1
+                                                     : QUALITY_DEPTH-1];
+            continue;
+        }
+
+        /* A well formed tree never has more pending than nodes */
+        if (n + 2U > tree->occ) return false;
+        if (nd->l != 0xFFFF)
+        {
+            stack[n].id    = nd->l;
+            stack[n].depth = v.depth + 1U;
+            ++n;
+        }
+        if (nd->r != 0xFFFF)
+        {
+            stack[n].id    = nd->r;
+            stack[n].depth = v.depth + 1U;
+            ++n;
+        }
+    }
+
+    q->depth_avg    = q->leaves ? (double)depth_sum / (double)q->leaves : 0.0;
+    q->coplanar_avg = (double)coplanar_sum / (double)q->nodes;
+    return true;
+}
+
+/* Nodes passed locating p: behind a plane goes left, as in the builder */
+static size_t
+quality_locate(bsp const *tree, pools const *pool, float const *p)
+{
+    bsp_ind id = 0;
+    size_t n = 0U;
+
+    while (id < tree->occ)
+    {
+        bsp_node const *nd = tree->d + id;
+
+        ++n;
+        id = vec3_distance_to_plane(pool->planes + nd->pl, p) < 0.0f ? nd->l
+                                                                      : nd->r;
+    }
+    return n;
+}
+
+/* Nodes whose cell the segment a-b crosses, and the faces on their planes */
+static void
+quality_trace(bsp const *tree, pools const *pool, float const *a,
+              float const *b, quality_span *stack, size_t *nodes,
+              size_t *faces)
+{
+    size_t n = 1U;
+
+    stack[0].id = 0;
+    memcpy(stack[0].a, a, sizeof(stack[0].a));
+    memcpy(stack[0].b, b, sizeof(stack[0].b));
+
+    while (n)
+    {
+        quality_span const s = stack[--n];
+        bsp_node const *nd;
+        plane const *p;
+        float da, db;
+
+        if (s.id >= tree->occ) continue;
+        nd = tree->d + s.id;
+        p  = pool->planes + nd->pl;
+
+        ++*nodes;
+        *faces += (size_t)nd->pr - nd->pl + 1U;
+
+        da = vec3_distance_to_plane(p, s.a);
+        db = vec3_distance_to_plane(p, s.b);
+        if ((da < 0.0f) == (db < 0.0f))
+        {
+            stack[n]    = s;
+            stack[n].id = da < 0.0f ? nd->l : nd->r;
+            ++n;
+        }
+        else if (n + 2U <= tree->occ)
+        {
+            float const t = da / (da - db);
+            float m[3];
+            unsigned k;
+
+            for (k = 0; k < 3; ++k) m[k] = s.a[k] + (s.b[k] - s.a[k]) * t;
+
+            stack[n]    = s;
+            stack[n].id = nd->l;
+            memcpy(da < 0.0f ? stack[n].b : stack[n].a, m, sizeof(m));
+            ++n;
+            stack[n]    = s;
+            stack[n].id = nd->r;
+            memcpy(da < 0.0f ? stack[n].a : stack[n].b, m, sizeof(m));
+            ++n;
+        }
+    }
+}
+
+bool
+quality_measure(bsp const *tree, pools const *pool, size_t faces_in,
+                size_t samples, quality *out)
+{
+    quality_visit *shape;
+    quality_span  *spans;
+    size_t i, pn = 0U, rn = 0U, rf = 0U;
+    unsigned seed = QUALITY_SEED;
+    bool ok;
+
+    if (!tree || !tree->d || !tree->box || !tree->occ ||
+        !pool || !pool->planes || !out)
+    {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->faces_in  = faces_in;
+    out->faces_out = pool->n_faces;
+    out->samples   = samples ? samples : QUALITY_SAMPLES;
+
+    shape = malloc(tree->occ * sizeof(*shape));
+    spans = malloc((tree->occ + 1U) * sizeof(*spans));
+    ok = shape && spans && quality_shape(tree, out, shape);
+
+    for (i = 0; ok && i < out->samples; ++i)
+    {
+        float a[3], b[3];
+
+        quality_point(tree->box, &seed, a);
+        quality_point(tree->box, &seed, b);
+        pn += quality_locate(tree, pool, a);
+        quality_trace(tree, pool, a, b, spans, &rn, &rf);
+    }
+    if (ok)
+    {
+        out->point_nodes = (double)pn / (double)out->samples;
+        out->ray_nodes   = (double)rn / (double)out->samples;
+        out->ray_faces   = (double)rf / (double)out->samples;
+    }
+
+    free(shape);
+    free(spans);
+    return ok;
+}
+
+
+
+bool
+quality_json(quality const *q, FILE *f)
+{
+    unsigned i, n;
+
+    if (!q || !f) return false;
+
+    fprintf(f, "{\"nodes\": %zu, \"leaves\": %zu, \"faces_in\": %zu, "
+               "\"faces_out\": %zu, \"split_ratio\": %.4f, "
+               "\"depth_max\": %u, \"depth_avg\": %.3f, \"depth_hist\": [",
+               q->nodes, q->leaves, q->faces_in, q->faces_out,
+               q->faces_in ? (double)q->faces_out / (double)q->faces_in : 0.0,
+               q->depth_max, q->depth_avg);
+    n = q->depth_max < QUALITY_DEPTH ? q->depth_max : QUALITY_DEPTH;
+    for (i = 0; i < n; ++i)
+        fprintf(f, i ? ", %zu" : "%zu", q->depth_hist[i]);
+    fprintf(f, "], \"coplanar_max\": %zu, \"coplanar_avg\": %.3f, "
+               "\"coplanar_hist\": [", q->coplanar_max, q->coplanar_avg);
+    for (i = 0; i < QUALITY_BUCKETS; ++i)
+        fprintf(f, i ? ", %zu" : "%zu", q->coplanar_hist[i]);
+    fprintf(f, "], \"samples\": %zu, \"point_nodes\": %.3f, "
+               "\"ray_nodes\": %.3f, \"ray_faces\": %.3f}",
+               q->samples, q->point_nodes, q->ray_nodes, q->ray_faces);
+
+    return !ferror(f);
+}
+
+void
+quality_print(quality const *q, FILE *f)
+{
+    if (!q || !f) return;
+
+    fprintf(f, "Tree: %zu nodes, %zu leaves, depth %.1f avg / %u max, "
+               "split ratio %.3f.\n"
+               "Query cost: %.1f nodes per point, %.1f nodes and %.1f faces "
+               "per ray.\n",
+               q->nodes, q->leaves, q->depth_avg, q->depth_max,
+               q->faces_in ? (double)q->faces_out / (double)q->faces_in : 0.0,
+               q->point_nodes, q->ray_nodes, q->ray_faces);
+}
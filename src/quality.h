@@ -0,0 +1,48 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Measures a finished tree by what it costs at query time: shape, splits,
+    and the nodes point and ray queries visit on average.
+*******************************************************************************/
+
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include "bsp.h"
+
+#include <stdio.h>
+
+#define QUALITY_DEPTH   64   /* Deeper leaves share the last entry */
+#define QUALITY_BUCKETS 17   /* Coplanar counts by power of two, to 2^16 */
+#define QUALITY_SAMPLES 4096 /* Default queries per estimate */
+
+typedef struct {
+    size_t   nodes, leaves;
+    size_t   faces_in, faces_out;         /* Before and after splitting */
+    unsigned depth_max;                   /* Root is depth 1 */
+    double   depth_avg;                   /* Over leaves */
+    size_t   depth_hist[QUALITY_DEPTH];   /* Leaves by depth - 1 */
+    size_t   coplanar_max;
+    double   coplanar_avg;                /* Faces on each node's plane */
+    size_t   coplanar_hist[QUALITY_BUCKETS]; /* [b]: 2^b to 2^(b+1)-1 */
+
+    /* Mean per query over points, and segments between point pairs, drawn
+     * uniformly from the root bounds */
+    size_t   samples;
+    double   point_nodes;                 /* Nodes to locate a point */
+    double   ray_nodes, ray_faces;        /* Nodes crossed, faces on them */
+} quality;
+
+/* Measures the tree built over the pool from faces_in faces, estimating
+ * query costs from `samples` queries (0 for QUALITY_SAMPLES) drawn from a
+ * fixed seed: the same tree always gives the same figures */
+bool quality_measure(bsp const *tree, pools const *pool, size_t faces_in,
+                     size_t samples, quality *out);
+
+/* One JSON object, no new line, to nest in other reports */
+bool quality_json (quality const *q, FILE *f);
+void quality_print(quality const *q, FILE *f);
+
+#endif /* QUALITY_H */
@@ -0,0 +1,667 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Spatial queries against a built BSP tree:
+    - segment occlusion (line of sight)
+    - swept sphere / box collision (time of impact and contact normal)
+*******************************************************************************/
+
+#include "query.h"
+#include "math.h"
+#include "thread.h"
+#include "verbose.h"
+
+#include <stdio.h>
+
+/* The builder leaves faces within a few ULPs of a node plane on either side
+ * of it, so split segments overlap the plane each way by this many ULPs of
+ * the scene's largest coordinate, past the builder's on-plane epsilon */
+#define QUERY_OVERLAP_ULPS 64.0f
+
+
+
+/* Point on a-b at distance `push` from the plane, given the end points'
+ * distances to it (clamped to the segment) */
+static inline void
+query_split(float *out,
+            float const *a, float const *b,
+            float da, float db, float push)
+{
+    float t = (da - push) / (da - db);
+
+    if (t < 0.0f) t = 0.0f;
+    if (t > 1.0f) t = 1.0f;
+    out[0] = a[0] + t*(b[0] - a[0]);
+    out[1] = a[1] + t*(b[1] - a[1]);
+    out[2] = a[2] + t*(b[2] - a[2]);
+}
+
+
+
+/* Overlap for the tree's scene, from its root bounds */
+static float
+query_overlap(bsp const *tree)
+{
+    bsp_box const *b = tree->box;
+    float m = 0.0f;
+    unsigned char j;
+
+    for (j = 0; j < 3; ++j)
+    {
+        if (fabsf(b->min[j]) > m) m = fabsf(b->min[j]);
+        if (fabsf(b->max[j]) > m) m = fabsf(b->max[j]);
+    }
+
+    /* Unbounded (not yet built): the epsilon alone */
+    if (!(m < FLT_MAX)) m = 0.0f;
+    return m * FLT_EPSILON * QUERY_OVERLAP_ULPS + PLANE_EPSILON;
+}
+
+/* Bounds of a-b, grown by reach[3] (NULL for none) and then by ov */
+static inline void
+query_bound(bsp_box *out, float const *a, float const *b, float const *reach,
+            float ov)
+{
+    unsigned char j;
+
+    for (j = 0; j < 3; ++j)
+    {
+        float const g = reach ? reach[j] : 0.0f;
+        out->min[j] = (a[j] < b[j] ? a[j] : b[j]) - g - ov;
+        out->max[j] = (a[j] > b[j] ? a[j] : b[j]) + g + ov;
+    }
+}
+
+
+
+static bool
+query_segment_node(bsp   const *tree,
+                   pools const *pool,
+                   bsp_ind      id,
+                   float const *a,
+                   float const *b,
+                   float        ov)
+{
+    float x[3], xn[3], xf[2][3];
+    unsigned char xi = 0;
+
+    /* Loop down the far side, recurse down the near side */
+    while (id < tree->occ)
+    {
+        bsp_node const *n = tree->d + id;
+        plane    const *p = pool->planes + n->pl;
+        float const da = vec3_distance_to_plane(p, a);
+        float const db = vec3_distance_to_plane(p, b);
+        unsigned short i;
+        bsp_box sb;
+
+        /* Nothing further down this side if the subtree is out of reach */
+        query_bound(&sb, a, b, NULL, ov);
+        if (!bsp_box_overlap(&sb, tree->box + id))
+            return false;
+
+        if (da > -PLANE_EPSILON && db > -PLANE_EPSILON)
+        {
+            /* Both on (or touching) the right */
+            if (da < PLANE_EPSILON && db < PLANE_EPSILON)
+            {
+                /* Lies in the plane: may graze either side */
+                if (query_segment_node(tree, pool, n->l, a, b, ov))
+                    return true;
+            }
+            id = n->r;
+            continue;
+        }
+        if (da < PLANE_EPSILON && db < PLANE_EPSILON)
+        {
+            /* Both on (or touching) the left */
+            id = n->l;
+            continue;
+        }
+
+        /* Strictly crosses the plane: test the node's faces at the crossing */
+        query_split(x, a, b, da, db, 0.0f);
+        for (i = n->pl; i <= n->pr; ++i)
+        {
+            if (face_contains_point(pool->planes + i, pool->verts,
+                                    pool->faces + i, x))
+            {
+                return true;
+            }
+        }
+
+        /* Near half first, then continue along the far half; both run
+         * slightly past the plane */
+        {
+            float const push = da < 0.0f ? ov : -ov;
+
+            query_split(xn,     a, b, da, db,  push);
+            query_split(xf[xi], a, b, da, db, -push);
+        }
+        if (query_segment_node(tree, pool, da < 0.0f ? n->l : n->r, a, xn,
+                               ov))
+        {
+            return true;
+        }
+
+        id = da < 0.0f ? n->r : n->l;
+        a  = xf[xi];
+        xi ^= 1;
+    }
+
+    return false;
+}
+
+
+
+bool
+query_segment_blocked(bsp   const *tree,
+                      pools const *pool,
+                      float const *a,
+                      float const *b)
+{
+    if (!tree || !tree->d || !pool || !pool->planes || !a || !b)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: query_segment_blocked() without tree, "
+                            "pool or segment.\n");
+        )
+        return false;
+    }
+
+    return query_segment_node(tree, pool, 0, a, b, query_overlap(tree));
+}
+
+
+
+bool
+query_segment_blocked_brute(pools const *pool,
+                            float const *a,
+                            float const *b)
+{
+    float x[3];
+    size_t i;
+
+    if (!pool || !pool->planes || !a || !b) return false;
+
+    for (i = 0; i < pool->n_faces; ++i)
+    {
+        plane const *p = pool->planes + i;
+        float const da = vec3_distance_to_plane(p, a);
+        float const db = vec3_distance_to_plane(p, b);
+
+        if ((da <= -PLANE_EPSILON && db >= PLANE_EPSILON) ||
+            (da >=  PLANE_EPSILON && db <= -PLANE_EPSILON))
+        {
+            query_split(x, a, b, da, db, 0.0f);
+            if (face_contains_point(p, pool->verts, pool->faces + i, x))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+typedef struct {
+    bsp           const *tree;
+    pools         const *pool;
+    query_segment const *segs;
+    bool                *out;
+    float                ov;
+} query_batch;
+
+static void
+query_segments_job(void *arg, size_t begin, size_t end)
+{
+    query_batch const *q = arg;
+    size_t i;
+
+    for (i = begin; i < end; ++i)
+    {
+        q->out[i] = query_segment_node(q->tree, q->pool, 0,
+                                       q->segs[i].a, q->segs[i].b, q->ov);
+    }
+}
+
+size_t
+query_segments_blocked(bsp           const *tree,
+                       pools         const *pool,
+                       query_segment const *segs,
+                       bool                *out,
+                       size_t               n,
+                       unsigned             threads)
+{
+    query_batch q;
+    size_t i, blocked = 0U;
+
+    if (!tree || !tree->d || !pool || !pool->planes || !segs || !out)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: query_segments_blocked() without tree, "
+                            "pool, segments or output.\n");
+        )
+        return 0U;
+    }
+
+    q.tree = tree;
+    q.pool = pool;
+    q.segs = segs;
+    q.out  = out;
+    q.ov   = query_overlap(tree);
+    thread_for(query_segments_job, &q, n, threads);
+
+    for (i = 0; i < n; ++i)
+        blocked += out[i];
+
+    return blocked;
+}
+
+
+
+/* A shape (sphere of radius r, or box of half extents ext) moving a to a+v */
+typedef struct {
+    pools const *pool;
+    float const *a;
+    float        v[3];
+    float        r, reach[3]; /* Sphere radius (and as box extents) */
+    float const *ext;
+    float        ov;  /* Overlap past node planes, as for segments */
+    query_hit   *hit;
+} query_sweep;
+
+static inline void
+query_hit_set(query_sweep *s, unsigned short i, float t, float const *n)
+{
+    s->hit->t    = t;
+    s->hit->face = i;
+    if (!vec3_norm(s->hit->n, n))
+    {
+        /* Touching exactly: fall back on the face normal */
+        s->hit->n[0] = s->pool->planes[i].m[0];
+        s->hit->n[1] = s->pool->planes[i].m[1];
+        s->hit->n[2] = s->pool->planes[i].m[2];
+    }
+}
+
+
+
+/* Earliest t in [0, 1] at which a point moving o to o+v enters the sphere
+ * (c, r); 0 if it starts inside. */
+static bool
+query_ray_sphere(float *t,
+                 float const *o, float const *v,
+                 float const *c, float r)
+{
+    double const m[3] = { (double)o[0] - c[0],
+                          (double)o[1] - c[1],
+                          (double)o[2] - c[2] };
+    double const vv = (double)v[0]*v[0] + (double)v[1]*v[1] + (double)v[2]*v[2];
+    double const b  = m[0]*v[0] + m[1]*v[1] + m[2]*v[2];
+    double const k  = m[0]*m[0] + m[1]*m[1] + m[2]*m[2] - (double)r*r;
+    double disc, x;
+
+    if (k <= 0.0)                 { *t = 0.0f; return true; }
+    if (b >= 0.0 || vv <= 0.0)    return false;
+    disc = b*b - vv*k;
+    if (disc < 0.0)               return false;
+    x = (-b - sqrt(disc)) / vv;
+    if (x > 1.0)                  return false;
+    *t = (float)x;
+    return true;
+}
+
+/* Earliest t in [0, 1] at which a point moving o to o+v enters the cylinder
+ * of radius r around p-q (flat caps left to the end point spheres); 0 if it
+ * starts inside. */
+static bool
+query_ray_cylinder(float *t,
+                   float const *o, float const *v,
+                   float const *p, float const *q, float r)
+{
+    double const d[3] = { (double)q[0] - p[0],
+                          (double)q[1] - p[1],
+                          (double)q[2] - p[2] };
+    double const m[3] = { (double)o[0] - p[0],
+                          (double)o[1] - p[1],
+                          (double)o[2] - p[2] };
+    double const dd = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+    double const md = m[0]*d[0] + m[1]*d[1] + m[2]*d[2];
+    double const nd = v[0]*d[0] + v[1]*d[1] + v[2]*d[2];
+    double const nn = (double)v[0]*v[0] + (double)v[1]*v[1] + (double)v[2]*v[2];
+    double const mn = m[0]*v[0] + m[1]*v[1] + m[2]*v[2];
+    double const mm = m[0]*m[0] + m[1]*m[1] + m[2]*m[2];
+    double const A  = dd*nn - nd*nd;
+    double const B  = dd*mn - nd*md;
+    double const C  = dd*(mm - (double)r*r) - md*md;
+    double disc, x, s;
+
+    if (dd <= 0.0) return false;
+    if (C <= 0.0)
+    {
+        /* Starts within the infinite cylinder */
+        if (md < 0.0 || md > dd) return false;
+        *t = 0.0f;
+        return true;
+    }
+    if (A <= DBL_EPSILON*dd*nn || B >= 0.0) return false;
+    disc = B*B - A*C;
+    if (disc < 0.0) return false;
+    x = (-B - sqrt(disc)) / A;
+    if (x > 1.0)    return false;
+    s = md + x*nd;
+    if (s < 0.0 || s > dd) return false;
+    *t = (float)x;
+    return true;
+}
+
+
+
+static void
+query_sphere_face(query_sweep *s, unsigned short i)
+{
+    plane const *p  = s->pool->planes + i;
+    vert  const *vs = s->pool->verts;
+    face  const *f  = s->pool->faces + i;
+    float const da  = vec3_distance_to_plane(p, s->a);
+    float const dv  = vec3_dot(p->m, s->v);
+    float const side = da < 0.0f ? -1.0f : 1.0f;
+    float c[3], n[3], t;
+    unsigned char k;
+
+    /* Face interior: first contact with the plane, if it lands inside */
+    t = -1.0f;
+    if (fabsf(da) <= s->r)
+        t = 0.0f;
+    else if (da*dv < 0.0f)
+        t = (side*s->r - da) / dv;
+    if (t >= 0.0f && t < s->hit->t)
+    {
+        c[0] = s->a[0] + t*s->v[0];
+        c[1] = s->a[1] + t*s->v[1];
+        c[2] = s->a[2] + t*s->v[2];
+        if (face_contains_point(p, vs, f, c))
+        {
+            n[0] = side*p->m[0];
+            n[1] = side*p->m[1];
+            n[2] = side*p->m[2];
+            query_hit_set(s, i, t, n);
+            return;
+        }
+    }
+
+    /* Otherwise the sphere can only meet an edge or a corner */
+    for (k = 0; k < 3; ++k)
+    {
+        float const *p0 = vs[f->i[k]].m;
+        float const *p1 = vs[f->i[k == 2 ? 0 : k+1]].m;
+
+        if (query_ray_cylinder(&t, s->a, s->v, p0, p1, s->r) && t < s->hit->t)
+        {
+            float e[3], w[3], u;
+
+            c[0] = s->a[0] + t*s->v[0];
+            c[1] = s->a[1] + t*s->v[1];
+            c[2] = s->a[2] + t*s->v[2];
+            vec3_sub(e, p1, p0);
+            vec3_sub(w, c, p0);
+            u = vec3_dot(w, e) / vec3_dot(e, e);
+            n[0] = c[0] - (p0[0] + u*e[0]);
+            n[1] = c[1] - (p0[1] + u*e[1]);
+            n[2] = c[2] - (p0[2] + u*e[2]);
+            query_hit_set(s, i, t, n);
+        }
+        if (query_ray_sphere(&t, s->a, s->v, p0, s->r) && t < s->hit->t)
+        {
+            c[0] = s->a[0] + t*s->v[0];
+            c[1] = s->a[1] + t*s->v[1];
+            c[2] = s->a[2] + t*s->v[2];
+            vec3_sub(n, c, p0);
+            query_hit_set(s, i, t, n);
+        }
+    }
+}
+
+
+
+/* Separating axis test over the motion: the box axes, the face normal and
+ * the nine edge cross products. The contact is where the last axis starts
+ * to overlap. */
+static void
+query_box_face(query_sweep *s, unsigned short i)
+{
+    plane const *p  = s->pool->planes + i;
+    vert  const *vs = s->pool->verts;
+    face  const *f  = s->pool->faces + i;
+    float const *tri[3];
+    float e[3][3], axis[3], n[3];
+    float first = -FLT_MAX, last = 1.0f;
+    unsigned char k;
+
+    tri[0] = vs[f->i[0]].m;
+    tri[1] = vs[f->i[1]].m;
+    tri[2] = vs[f->i[2]].m;
+    vec3_sub(e[0], tri[1], tri[0]);
+    vec3_sub(e[1], tri[2], tri[1]);
+    vec3_sub(e[2], tri[0], tri[2]);
+
+    n[0] = vec3_distance_to_plane(p, s->a) < 0.0f ? -p->m[0] : p->m[0];
+    n[1] = vec3_distance_to_plane(p, s->a) < 0.0f ? -p->m[1] : p->m[1];
+    n[2] = vec3_distance_to_plane(p, s->a) < 0.0f ? -p->m[2] : p->m[2];
+
+    for (k = 0; k < 13; ++k)
+    {
+        float pc, pv, rb, lo, hi, t0, t1, p0, p1, p2;
+
+        if (k < 3)
+        {
+            axis[0] = k == 0; axis[1] = k == 1; axis[2] = k == 2;
+        }
+        else if (k == 3)
+        {
+            axis[0] = p->m[0]; axis[1] = p->m[1]; axis[2] = p->m[2];
+        }
+        else
+        {
+            float const unit[3] = { (k-4)/3 == 0, (k-4)/3 == 1, (k-4)/3 == 2 };
+            vec3_cross(axis, unit, e[(k-4)%3]);
+            if (!vec3_norm(axis, axis)) continue; /* Edge along this box axis */
+        }
+
+        pc = vec3_dot(axis, s->a);
+        pv = vec3_dot(axis, s->v);
+        rb = s->ext[0]*fabsf(axis[0]) +
+             s->ext[1]*fabsf(axis[1]) +
+             s->ext[2]*fabsf(axis[2]);
+        p0 = vec3_dot(axis, tri[0]);
+        p1 = vec3_dot(axis, tri[1]);
+        p2 = vec3_dot(axis, tri[2]);
+        lo = (p0 < p1 ? (p0 < p2 ? p0 : p2) : (p1 < p2 ? p1 : p2)) - rb;
+        hi = (p0 > p1 ? (p0 > p2 ? p0 : p2) : (p1 > p2 ? p1 : p2)) + rb;
+
+        if (pv == 0.0f)
+        {
+            if (pc < lo || pc > hi) return;
+            continue;
+        }
+        t0 = (lo - pc) / pv;
+        t1 = (hi - pc) / pv;
+        if (t0 > t1) { float const swp = t0; t0 = t1; t1 = swp; }
+
+        if (t0 > first)
+        {
+            /* Entering over lo means approaching from the negative side */
+            float const sgn = pv > 0.0f ? -1.0f : 1.0f;
+            first = t0;
+            n[0] = sgn*axis[0];
+            n[1] = sgn*axis[1];
+            n[2] = sgn*axis[2];
+        }
+        if (t1 < last) last = t1;
+        if (first > last || last < 0.0f) return;
+    }
+
+    if (first < 0.0f) first = 0.0f;
+    if (first < s->hit->t)
+        query_hit_set(s, i, first, n);
+}
+
+
+
+static void
+query_sweep_node(bsp const *tree, query_sweep *s, bsp_ind id,
+                 float t0, float t1)
+{
+    while (id < tree->occ && t0 <= t1 && t0 < s->hit->t)
+    {
+        bsp_node const *nd = tree->d + id;
+        plane    const *p  = s->pool->planes + nd->pl;
+        float const da = vec3_distance_to_plane(p, s->a);
+        float const dv = vec3_dot(p->m, s->v);
+        float const d0 = da + t0*dv;
+        float const d1 = da + t1*dv;
+        float const e  = s->ov + (s->ext ?
+                         s->ext[0]*fabsf(p->m[0]) +
+                         s->ext[1]*fabsf(p->m[1]) +
+                         s->ext[2]*fabsf(p->m[2]) : s->r);
+        float rt0 = t0, rt1 = t1, lt0 = t0, lt1 = t1;
+        float p0[3], p1[3];
+        unsigned short i;
+        bsp_box sb;
+
+        p0[0] = s->a[0] + t0*s->v[0];
+        p0[1] = s->a[1] + t0*s->v[1];
+        p0[2] = s->a[2] + t0*s->v[2];
+        p1[0] = s->a[0] + t1*s->v[0];
+        p1[1] = s->a[1] + t1*s->v[1];
+        p1[2] = s->a[2] + t1*s->v[2];
+        query_bound(&sb, p0, p1, s->ext ? s->ext : s->reach, s->ov);
+        if (!bsp_box_overlap(&sb, tree->box + id))
+            return;
+
+        /* The plane expanded by the shape's reach decides the sides */
+        if (d0 >= e && d1 >= e)   { id = nd->r; continue; }
+        if (d0 <= -e && d1 <= -e) { id = nd->l; continue; }
+
+        for (i = nd->pl; i <= nd->pr; ++i)
+        {
+            if (s->ext) query_box_face(s, i);
+            else        query_sphere_face(s, i);
+        }
+
+        /* Narrow each side to the times the shape reaches into it */
+        if (dv > 0.0f)
+        {
+            float const tr = (-e - da) / dv, tl = (e - da) / dv;
+            if (tr > rt0) rt0 = tr;
+            if (tl < lt1) lt1 = tl;
+        }
+        else if (dv < 0.0f)
+        {
+            float const tr = (-e - da) / dv, tl = (e - da) / dv;
+            if (tr < rt1) rt1 = tr;
+            if (tl > lt0) lt0 = tl;
+        }
+
+        /* Near side first: its contacts come earlier */
+        if (d0 >= 0.0f)
+        {
+            query_sweep_node(tree, s, nd->r, rt0, rt1);
+            id = nd->l; t0 = lt0; t1 = lt1;
+        }
+        else
+        {
+            query_sweep_node(tree, s, nd->l, lt0, lt1);
+            id = nd->r; t0 = rt0; t1 = rt1;
+        }
+    }
+}
+
+static bool
+query_sweep_run(bsp const *tree, pools const *pool,
+                float const *a, float const *b,
+                float r, float const *ext,
+                query_hit *hit)
+{
+    query_sweep s;
+    size_t i;
+
+    if (!pool || !pool->planes || !a || !b || !hit) return false;
+
+    s.pool = pool;
+    s.a    = a;
+    vec3_sub(s.v, b, a);
+    s.r    = r;
+    s.reach[0] = s.reach[1] = s.reach[2] = r;
+    s.ext  = ext;
+    s.ov   = tree ? query_overlap(tree) : 0.0f;
+    s.hit  = hit;
+    hit->t = 2.0f; /* No contact yet */
+
+    if (tree)
+        query_sweep_node(tree, &s, 0, 0.0f, 1.0f);
+    else for (i = 0; i < pool->n_faces; ++i)
+    {
+        if (ext) query_box_face(&s, (unsigned short)i);
+        else     query_sphere_face(&s, (unsigned short)i);
+    }
+
+    return hit->t <= 1.0f;
+}
+
+
+
+bool
+query_sweep_sphere(bsp   const *tree,
+                   pools const *pool,
+                   float const *a,
+                   float const *b,
+                   float        r,
+                   query_hit   *hit)
+{
+    if (!tree || !tree->d)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: query_sweep_sphere() without tree.\n");
+        )
+        return false;
+    }
+    return query_sweep_run(tree, pool, a, b, r, NULL, hit);
+}
+
+bool
+query_sweep_box(bsp   const *tree,
+                pools const *pool,
+                float const *a,
+                float const *b,
+                float const *ext,
+                query_hit   *hit)
+{
+    if (!tree || !tree->d || !ext)
+    {
+        VERBOSE_2
+        (
+            fprintf(stderr, "WARNING: query_sweep_box() without tree or "
+                            "extents.\n");
+        )
+        return false;
+    }
+    return query_sweep_run(tree, pool, a, b, 0.0f, ext, hit);
+}
+
+bool
+query_sweep_brute(pools const *pool,
+                  float const *a,
+                  float const *b,
+                  float        r,
+                  float const *ext,
+                  query_hit   *hit)
+{
+    return query_sweep_run(NULL, pool, a, b, r, ext, hit);
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Spatial queries against a built BSP tree:
+    - segment occlusion (line of sight)
+    - swept sphere / box collision (time of impact and contact normal)
+*******************************************************************************/
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "bsp.h"
+
+typedef struct {
+    float a[3], b[3];
+} query_segment;
+
+/* True if any face strictly crosses the segment a-b. Touching a face with an
+ * end point or grazing along its plane does not block. */
+bool query_segment_blocked(bsp   const *tree,
+                           pools const *pool,
+                           float const *a,
+                           float const *b);
+
+/* Same answer, testing every face (reference and baseline) */
+bool query_segment_blocked_brute(pools const *pool,
+                                 float const *a,
+                                 float const *b);
+
+/* Answers n segments into out[] over `threads` threads (0 = all processors).
+ * Returns the number of blocked segments. */
+size_t query_segments_blocked(bsp           const *tree,
+                              pools         const *pool,
+                              query_segment const *segs,
+                              bool                *out,
+                              size_t               n,
+                              unsigned             threads);
+
+typedef struct {
+    float          t;    /* Time of impact along a-b, 0 to 1 */
+    float          n[3]; /* Contact normal, from the face towards the shape */
+    unsigned short face; /* Face touched */
+} query_hit;
+
+/* Sweeps a sphere of radius r, centred at a, to b. Returns true and fills
+ * *hit with the first contact, if any; a shape that starts touching a face
+ * hits at t = 0. Only the nodes the swept shape reaches are visited. */
+bool query_sweep_sphere(bsp   const *tree,
+                        pools const *pool,
+                        float const *a,
+                        float const *b,
+                        float        r,
+                        query_hit   *hit);
+
+/* Same, for an axis aligned box of half extents ext[3] */
+bool query_sweep_box(bsp   const *tree,
+                     pools const *pool,
+                     float const *a,
+                     float const *b,
+                     float const *ext,
+                     query_hit   *hit);
+
+/* Either sweep testing every face (ext = NULL for a sphere of radius r) */
+bool query_sweep_brute(pools const *pool,
+                       float const *a,
+                       float const *b,
+                       float        r,
+                       float const *ext,
+                       query_hit   *hit);
+
+#endif /* QUERY_H */
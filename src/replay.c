@@ -0,0 +1,311 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Compact log of build events, recorded at full speed by the builder and
+    stepped through afterwards in the viewer.
+*******************************************************************************/
+
+#include "replay.h"
+#include "clip.h"
+#include "draw.h"
+#include "select.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_VER 1U
+
+typedef struct {
+    char     magic[4];   /* "BSPR" */
+    uint32_t version;
+    uint32_t event_size;
+    uint32_t verts, faces;
+    uint64_t n;
+} replay_header;
+
+extern unsigned short g_bsp_l, g_bsp_r, g_pivot_l, g_pivot_r,
+                      g_poly_clip, g_poly_inter, g_vert_012[3];
+extern DRAW_MODE g_draw_mode;
+
+
+
+void
+replay_log_init(replay_log *log)
+{
+    if (!log) return;
+
+    log->e     = NULL;
+    log->n     = log->cap   = 0U;
+    log->verts = log->faces = 0U;
+    log->full  = false;
+}
+
+void
+replay_log_free(replay_log *log)
+{
+    if (!log) return;
+
+    free(log->e);
+    replay_log_init(log);
+}
+
+void
+replay_log_clear(replay_log *log, pools const *from)
+{
+    if (!log) return;
+
+    log->n     = 0U;
+    log->verts = from ? from->n_verts : 0U;
+    log->faces = from ? from->n_faces : 0U;
+    log->full  = false;
+}
+
+void
+replay_log_push(replay_log *log, REPLAY_KIND kind,
+                unsigned short l,  unsigned short r,
+                unsigned short pl, unsigned short pr,
+                unsigned short i)
+{
+    replay_event *e;
+
+    if (!log || log->full) return;
+
+    if (log->n == log->cap)
+    {
+        size_t const cap = log->cap ? log->cap*2U : 4096U;
+        replay_event *grown = realloc(log->e, cap * sizeof(*grown));
+
+        if (!grown)
+        {
+            fprintf(stderr, "Build log full at %zu events.\n", log->n);
+            log->full = true;
+            return;
+        }
+        log->e   = grown;
+        log->cap = cap;
+    }
+
+    e = log->e + log->n++;
+    e->kind = (unsigned char)kind;
+    e->pad  = 0U;
+    e->l  = l;  e->r  = r;
+    e->pl = pl; e->pr = pr;
+    e->i  = i;
+}
+
+
+
+bool
+replay_write(replay_log const *log, char const *path)
+{
+    replay_header h;
+    FILE *f;
+    bool ok;
+
+    if (!log || !path) return false;
+
+    f = fopen(path, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open build log \"%s\".\n", path);
+        return false;
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "BSPR", 4);
+    h.version    = REPLAY_VER;
+    h.event_size = sizeof(replay_event);
+    h.verts      = (uint32_t)log->verts;
+    h.faces      = (uint32_t)log->faces;
+    h.n          = log->n;
+
+    ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+         fwrite(log->e, sizeof(replay_event), log->n, f) == log->n;
+    ok = !fclose(f) && ok;
+
+    if (!ok) fprintf(stderr, "Failed to write build log \"%s\".\n", path);
+    return ok;
+}
+
+bool
+replay_read(replay_log *log, char const *path)
+{
+    replay_header h;
+    FILE *f;
+    long size;
+    bool ok;
+
+    if (!log || !path) return false;
+
+    f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open build log \"%s\".\n", path);
+        return false;
+    }
+
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, "BSPR", 4) ||
+        h.version != REPLAY_VER || h.event_size != sizeof(replay_event))
+    {
+        fprintf(stderr, "\"%s\" is not a build log.\n", path);
+        fclose(f);
+        return false;
+    }
+
+    /* The count must be what the file holds, before it sizes anything */
+    if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < (long)sizeof(h) ||
+        ((size_t)size - sizeof(h)) % sizeof(replay_event) ||
+        h.n != ((size_t)size - sizeof(h)) / sizeof(replay_event) ||
+        fseek(f, (long)sizeof(h), SEEK_SET))
+    {
+        fprintf(stderr, "Build log \"%s\" does not hold the %llu events "
+                        "it counts.\n", path, (unsigned long long)h.n);
+        fclose(f);
+        return false;
+    }
+
+    replay_log_free(log);
+    log->e = malloc((h.n ? h.n : 1U) * sizeof(replay_event));
+    ok = log->e && fread(log->e, sizeof(replay_event), h.n, f) == h.n;
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "Build log \"%s\" is truncated.\n", path);
+        replay_log_free(log);
+        return false;
+    }
+
+    log->n     = log->cap = h.n;
+    log->verts = h.verts;
+    log->faces = h.faces;
+    return true;
+}
+
+
+
+bool
+replay_view_begin(replay_view *view, pools const *pool)
+{
+    if (!view || !pool) return false;
+
+    if (view->log.verts != pool->n_verts || view->log.faces != pool->n_faces)
+    {
+        fprintf(stderr, "Build log was recorded from %zu verts and %zu "
+                        "faces, not %zu and %zu.\n",
+                        view->log.verts, view->log.faces,
+                        pool->n_verts, pool->n_faces);
+        return false;
+    }
+
+    view->at      = 0U;
+    view->pending = false;
+    return true;
+}
+
+/* Redoes what the builder did at the event */
+static void
+replay_apply(replay_event const *e, pools *pool)
+{
+    clip_pivot cp;
+    unsigned short inc;
+
+    switch (e->kind)
+    {
+    case REPLAY_MOVE_LEFT:
+        select_move_left(pool, e->pl, e->pr, e->i);
+        break;
+
+    case REPLAY_MOVE_RIGHT:
+        select_move_right(pool, e->pl, e->pr, e->i);
+        break;
+
+    case REPLAY_MOVE_COINCIDE:
+        select_move_coincident(pool, e->pl, e->pr, e->i);
+        break;
+
+    case REPLAY_CLIP:
+        cp.l  = e->l;  cp.r  = e->r;
+        cp.pl = e->pl; cp.pr = e->pr;
+        if (!pools_reserve(pool, 2, 2) ||
+            !clip_face(&cp, pool, e->i, e->pl, &inc))
+        {
+            fprintf(stderr, "Build log clip did not replay.\n");
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+replay_show(replay_event const *e, pools *pool)
+{
+    unsigned short in, bal;
+
+    g_bsp_l   = e->l;
+    g_bsp_r   = e->r;
+    g_pivot_l = e->pl;
+    g_pivot_r = e->pr;
+
+    switch (e->kind)
+    {
+    case REPLAY_CLIP:
+        g_draw_mode   = DRAW_MODE_CLIP;
+        g_poly_clip   = e->pl;
+        g_poly_inter  = e->i;
+        g_vert_012[0] = pool->faces[e->i].i[0];
+        g_vert_012[1] = pool->faces[e->i].i[1];
+        g_vert_012[2] = pool->faces[e->i].i[2];
+        break;
+
+    case REPLAY_PIVOT:
+        /* Colour the range by its side of the chosen pivot */
+        select_get_props(pool, &in, &bal, e->l, e->i, e->r);
+        g_draw_mode = DRAW_MODE_REL;
+        break;
+
+    case REPLAY_NODE:
+        g_draw_mode = DRAW_MODE_LR;
+        break;
+
+    default:
+        g_draw_mode = DRAW_MODE_REL;
+        break;
+    }
+}
+
+bool
+replay_step(replay_view *view, pools *pool)
+{
+    replay_event const *e;
+
+    if (!view || !pool) return false;
+
+    if (view->pending)
+    {
+        replay_apply(view->log.e + view->at - 1U, pool);
+        view->pending = false;
+    }
+    if (view->at >= view->log.n) return false;
+
+    /* The moves and clips trust their ranges: a log that does not fit
+     * this pool would take them out of bounds */
+    e = view->log.e + view->at++;
+    if ((e->kind != REPLAY_NODE && e->i >= pool->n_faces) ||
+        e->pl > e->pr || e->pr >= pool->n_faces ||
+        e->l > e->pl  || e->r > pool->n_faces)
+    {
+        fprintf(stderr, "Build log event %zu is out of range.\n",
+                        view->at - 1U);
+        view->at = view->log.n;
+        return false;
+    }
+    replay_show(e, pool);
+    view->pending = true;
+    return true;
+}
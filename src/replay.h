@@ -0,0 +1,70 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Compact log of build events, recorded at full speed by the builder and
+    stepped through afterwards in the viewer.
+*******************************************************************************/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "pools.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    REPLAY_PIVOT = 1,     /* Pivot i chosen over [l, r) */
+    REPLAY_MOVE_LEFT,     /* Face i moved left of pivot [pl, pr] */
+    REPLAY_MOVE_RIGHT,    /* Face i moved right of pivot [pl, pr] */
+    REPLAY_MOVE_COINCIDE, /* Face i joined pivot [pl, pr] */
+    REPLAY_CLIP,          /* Face i split by the plane of pl */
+    REPLAY_NODE,          /* Node i created over pivot [pl, pr] */
+} REPLAY_KIND;
+
+/* Ranges are as they were when the event happened */
+typedef struct {
+    unsigned char  kind, pad;
+    unsigned short l, r, pl, pr, i;
+} replay_event;
+
+typedef struct {
+    replay_event *e;
+    size_t        n, cap;
+    size_t        verts, faces; /* Pool counts the build started from */
+    bool          full;         /* Could not grow: later events dropped */
+} replay_log;
+
+/* A log being stepped through over the pools it was recorded from */
+typedef struct {
+    replay_log log;
+    size_t     at;      /* Next event */
+    bool       pending; /* The event shown last is yet to be applied */
+} replay_view;
+
+
+
+void replay_log_init (replay_log *log);
+void replay_log_free (replay_log *log);
+void replay_log_clear(replay_log *log, pools const *from);
+
+/* Records an event, doing nothing without a log. A log that cannot grow
+ * drops the rest of the build and says so once. */
+void replay_log_push(replay_log *log, REPLAY_KIND kind,
+                     unsigned short l,  unsigned short r,
+                     unsigned short pl, unsigned short pr,
+                     unsigned short i);
+
+bool replay_write(replay_log const *log, char const *path);
+bool replay_read (replay_log *log, char const *path);
+
+/* Checks the log starts from these pools, and rewinds the view */
+bool replay_view_begin(replay_view *view, pools const *pool);
+
+/* Applies the event shown last to the pools, then shows the next one
+ * through the draw globals. False at the end of the log. */
+bool replay_step(replay_view *view, pools *pool);
+
+#endif /* REPLAY_H */
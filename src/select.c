@@ -11,18 +11,24 @@
 *******************************************************************************/
 
 #include "clip.h"
-#include "draw.h"
 #include "math.h"
+#include "mem.h"
 #include "bsp.h"
 #include "select.h"
+#include "timer.h"
+#include "trace.h"
 #include "verbose.h"
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define SELF pools *const self
 
+#define SELECT_SPLIT_EST 8U /* Faces per split expected in a whole build */
+#define SELECT_LANES    16U /* Faces classified at once by select_get_props */
+
 #ifndef PLANE_REL_DEF
 #define PLANE_REL_DEF
 typedef enum {
@@ -35,13 +41,8 @@ typedef enum {
 
 
 
-extern unsigned short g_bsp_l, g_pivot_l, g_pivot_r, g_bsp_r;
+extern unsigned short g_bsp_l, g_bsp_r;
 extern bsp g_bsp;
-extern DRAW_MODE g_draw_mode;
-
-static unsigned int swaps  = 0U;
-static unsigned int rdepth = 0U;
-       unsigned int clips  = 0U;
 
 
 
@@ -53,53 +54,42 @@ select_get_props(SELF,
                  unsigned short fi,
                  unsigned short r)
 {
-    plane *p = self->planes + fi;
+    static PLANE_REL const rel[4] = {
+        PLANE_REL_COINCIDE, PLANE_REL_LEFT, PLANE_REL_RIGHT, PLANE_REL_INTER
+    };
+    plane const p = self->planes[fi];
     face  *f = self->faces;
     vert  *v = self->verts;
 
-    unsigned short ints = 0, i;
+    float x[3*SELECT_LANES], y[3*SELECT_LANES], z[3*SELECT_LANES];
+    unsigned char side[3*SELECT_LANES];
+    unsigned short ints = 0, i, n, k;
                int  bal = 0;
 
-    /* Iterate per faces */
-    for (i = l; i < r; ++i)
+    /* Classify SELECT_LANES faces at a time: gather their vertices into
+     * lanes, take all the sides at once, then combine them per face */
+    for (i = l; i < r; i += n)
     {
-        bool pos = false, neg = false;
-        float d;
-
-        /* Derive the vertex distances of each face from the plane */
-        d = vec3_distance_to_plane(p, v[f[i].i[0]].m);
-             if (d <= -FLT_EPSILON) neg = true;
-        else if (d >=  FLT_EPSILON) pos = true;
-
-        d = vec3_distance_to_plane(p, v[f[i].i[1]].m);
-             if (d <= -FLT_EPSILON) neg = true;
-        else if (d >=  FLT_EPSILON) pos = true;
+        n = (unsigned short)(r - i);
+        if (n > SELECT_LANES) n = SELECT_LANES;
+        for (k = 0; k < n; ++k)
+        {
+            float const *a = v[f[i + k].i[0]].m, *b = v[f[i + k].i[1]].m,
+                        *c = v[f[i + k].i[2]].m;
 
-        if (neg && pos) {
-            ++ints;
-            self->planes[i].rel = PLANE_REL_INTER;
-            continue;
+            x[3*k] = a[0]; x[3*k + 1] = b[0]; x[3*k + 2] = c[0];
+            y[3*k] = a[1]; y[3*k + 1] = b[1]; y[3*k + 2] = c[1];
+            z[3*k] = a[2]; z[3*k + 1] = b[2]; z[3*k + 2] = c[2];
         }
+        vec3_side_of_plane_lanes(&p, x, y, z, side, 3U*n);
 
-        d = vec3_distance_to_plane(p, v[f[i].i[2]].m);
-             if (d <= -FLT_EPSILON) neg = true;
-        else if (d >=  FLT_EPSILON) pos = true;
-
-        if (neg) {
-            if (pos) {
-                ++ints;
-                self->planes[i].rel = PLANE_REL_INTER;
-            } else {
-                -- bal;
-                self->planes[i].rel = PLANE_REL_LEFT;
-            }
-        } else {
-            if (pos) {
-                ++ bal;
-                self->planes[i].rel = PLANE_REL_RIGHT;
-            } else {
-                self->planes[i].rel = PLANE_REL_COINCIDE;
-            }
+        for (k = 0; k < n; ++k)
+        {
+            unsigned const s = side[3*k] | side[3*k + 1] | side[3*k + 2];
+
+            ints += s == 3U;
+            bal  += (s == 2U) - (s == 1U);
+            self->planes[i + k].rel = rel[s];
         }
     }
 
@@ -113,8 +103,12 @@ PLANE_REL
 select_rel(plane *p, face *f, vert *verts)
 {
     /* Determine relationship */
-    bool pos = false, neg = false;
-    float d;
+    static PLANE_REL const rel[4] = {
+        PLANE_REL_COINCIDE, PLANE_REL_LEFT, PLANE_REL_RIGHT, PLANE_REL_INTER
+    };
+    float x[3], y[3], z[3];
+    unsigned char side[3];
+    unsigned k;
     
 #if VERBOSE >= 2
     if (!p)
@@ -134,30 +128,16 @@ select_rel(plane *p, face *f, vert *verts)
     }
 #endif
 
-    /* Derive the vertex distances of each face from the plane */
-    d = vec3_distance_to_plane(p, verts[f->i[0]].m);
-         if (d <= -FLT_EPSILON) neg = true;
-    else if (d >=  FLT_EPSILON) pos = true;
-
-    d = vec3_distance_to_plane(p, verts[f->i[1]].m);
-         if (d <= -FLT_EPSILON) neg = true;
-    else if (d >=  FLT_EPSILON) pos = true;
-
-    /* Early intersection test opportunity */
-    if (neg && pos)
-        return PLANE_REL_INTER;
-
-    /* Test final vertex */
-    d = vec3_distance_to_plane(p, verts[f->i[2]].m);
-         if (d <= -FLT_EPSILON) neg = true;
-    else if (d >=  FLT_EPSILON) pos = true;
-
-    /* Summarise */
-    if (neg) {
-        return pos ? PLANE_REL_INTER : PLANE_REL_LEFT;
-    } else {
-        return pos ? PLANE_REL_RIGHT : PLANE_REL_COINCIDE;
+    /* Take the sides of all three vertices at once */
+    for (k = 0; k < 3U; ++k)
+    {
+        x[k] = verts[f->i[k]].m[0];
+        y[k] = verts[f->i[k]].m[1];
+        z[k] = verts[f->i[k]].m[2];
     }
+    vec3_side_of_plane_lanes(p, x, y, z, side, 3U);
+
+    return rel[side[0] | side[1] | side[2]];
 }
 
 
@@ -201,8 +181,6 @@ select_move_left_simple(SELF,
                               elem, pivot);)
 
 
-    ++swaps;
-    
     /* First take out pivot */
     f_swp = self->faces[pivot];
     p_swp = self->planes[pivot];
@@ -266,8 +244,6 @@ select_move_right_simple(SELF,
                               elem, pivot);)
 
 
-    ++swaps;
-    
     /* First take out pivot */
     f_swp = self->faces[pivot];
     p_swp = self->planes[pivot];
@@ -349,8 +325,6 @@ select_move_left(SELF,
                               elem, pivot_l, pivot_r);)
 
 
-    ++swaps;
-     
     /* First take out neighbour */
     f_swp = self->faces [pivot_r+1];
     p_swp = self->planes[pivot_r+1];
@@ -434,8 +408,6 @@ select_move_right(SELF,
                               elem, pivot_l, pivot_r);)
 
 
-    ++swaps;
-    
     /* First take out neighbour */
     f_swp = self->faces [pivot_l-1];
     p_swp = self->planes[pivot_l-1];
@@ -496,8 +468,6 @@ void select_move_coincident(SELF,
                               elem, pivot_l, pivot_r);)
 
 
-    ++swaps;
-
     if (elem < pivot_l)
     {
         if ((size_t)(pivot_l-1) >= self->n_faces)
@@ -522,8 +492,9 @@ void select_move_coincident(SELF,
         
         if (elem == pivot_l-1)
         {
-            self->faces [pivot_r] = self->faces [elem];
-            self->planes[pivot_r] = self->planes[elem];
+            /* The element was the neighbour, now overwritten by the pivot */
+            self->faces [pivot_r] = f_swp;
+            self->planes[pivot_r] = p_swp;
         }
         else
         {
@@ -570,31 +541,34 @@ void select_move_coincident(SELF,
 
 
 
-void draw_set_clip(clip_pivot const *pv)
+/* Room for one more split. select_iter reserves every split of a node
+ * before partitioning it, so running out is a bug, not a reason to grow. */
+static bool
+select_reserved(pools const *self)
 {
-    if (pv)
-    {
-        g_bsp_l = pv->l;
-        g_bsp_r = pv->r;
-        g_pivot_l = pv->pl;
-        g_pivot_r = pv->pr;
-    }
-    else
-    {
-        g_bsp_l = 0;
-        g_bsp_r = -1;
-        g_pivot_l = 0;
-        g_pivot_r = 0;
-    }
+    if (self->n_verts + 2U <= self->c_verts &&
+        self->n_faces + 2U <= self->c_faces) return true;
+
+    fprintf(stderr, "ERROR: Split past the pools reserved for it (%zu/%zu "
+                    "verts, %zu/%zu faces).\n", self->n_verts, self->c_verts,
+                    self->n_faces, self->c_faces);
+    VERBOSE_1(raise(SIGINT);)
+    return false;
 }
 
-
-
-/* Returns position of pivot after partitioning */
+/* Returns position of pivot after partitioning, or 0xFFFF on failure */
 bsp_ind
-select_partition(SELF, clip_pivot *pivot)
+select_partition(SELF, clip_pivot *pivot, select_stats *st, select_level *lv)
 {
     clip_pivot cp = *pivot;
+    perf_group const *perf = perf_on(st->perf) ? st->perf : NULL;
+    replay_log *log = st->log;
+    perf_counts c0;
+    size_t n0;
+
+    /* Coplanar faces take over as cp.pl as they gather: classify against
+     * the plane select_iter counted splits with, not whichever is there */
+    plane pp = self->planes[cp.pl];
 
     unsigned short i, inc;
 
@@ -602,59 +576,64 @@ select_partition(SELF, clip_pivot *pivot)
     /* Move anything left of pivot to the right if applicable */
     for (i = cp.l; i < cp.pl; ++i)
     {
-        VERBOSE_3
-        (
-            draw_set_clip(pivot);
-            draw_pause();
-        )
-        
-        switch (select_rel(self->planes + cp.pl, self->faces + i, self->verts))
+        ++lv->classified;
+        switch (select_rel(&pp, self->faces + i, self->verts))
         {
         case PLANE_REL_LEFT:
             // As intended
             break;
 
         case PLANE_REL_RIGHT:
+            replay_log_push(log, REPLAY_MOVE_RIGHT,
+                            cp.l, cp.r, cp.pl, cp.pr, i);
             select_move_right(self, cp.pl, cp.pr, i);
+            ++lv->swaps;
             --cp.pl; --cp.pr; --i;
             break;
 
         case PLANE_REL_INTER:
         #ifndef NO_CLIPPING
+            if (!select_reserved(self)) return 0xFFFF;
+            n0 = self->n_faces;
+            if (perf) perf_read(perf, &c0);
+            replay_log_push(log, REPLAY_CLIP, cp.l, cp.r, cp.pl, cp.pr, i);
+            trace_begin("clip_face");
             clip_face(&cp, self, i, cp.pl, &inc);
+            trace_end();
+            if (perf) perf_accum(perf, &c0, &lv->c_clip);
             i += inc;
+            ++lv->splits;
+            lv->new_faces += self->n_faces - n0;
         #else
+            replay_log_push(log, REPLAY_MOVE_COINCIDE,
+                            cp.l, cp.r, cp.pl, cp.pr, i);
             select_move_coincident(self, cp.pl, cp.pr, i);
+            ++lv->swaps;
             --cp.pl; --i;
         #endif
             break;
 
         case PLANE_REL_COINCIDE:
+            replay_log_push(log, REPLAY_MOVE_COINCIDE,
+                            cp.l, cp.r, cp.pl, cp.pr, i);
             select_move_coincident(self, cp.pl, cp.pr, i);
+            ++lv->swaps;
             --cp.pl; --i;
             break;
         }
-        
-        VERBOSE_3
-        (
-            draw_set_clip(pivot);
-            draw_pause();
-        )
     }
 
     /* Move anything right of the pivot to the left if applicable */
     for (i = cp.pr+1; i < cp.r; ++i)
     {
-        VERBOSE_3
-        (
-            draw_set_clip(pivot);
-            draw_pause();
-        )
-        
-        switch (select_rel(self->planes + cp.pl, self->faces + i, self->verts))
+        ++lv->classified;
+        switch (select_rel(&pp, self->faces + i, self->verts))
         {
         case PLANE_REL_LEFT:
+            replay_log_push(log, REPLAY_MOVE_LEFT,
+                            cp.l, cp.r, cp.pl, cp.pr, i);
             select_move_left(self, cp.pl, cp.pr, i);
+            ++lv->swaps;
             ++cp.pl; ++cp.pr;
             if (cp.pr+1 < i) --i;
             break;
@@ -665,26 +644,35 @@ select_partition(SELF, clip_pivot *pivot)
 
         case PLANE_REL_INTER:
         #ifndef NO_CLIPPING
+            if (!select_reserved(self)) return 0xFFFF;
+            n0 = self->n_faces;
+            if (perf) perf_read(perf, &c0);
+            replay_log_push(log, REPLAY_CLIP, cp.l, cp.r, cp.pl, cp.pr, i);
+            trace_begin("clip_face");
             clip_face(&cp, self, i, cp.pl, &inc);
+            trace_end();
+            if (perf) perf_accum(perf, &c0, &lv->c_clip);
             i += inc;
+            ++lv->splits;
+            lv->new_faces += self->n_faces - n0;
         #else
+            replay_log_push(log, REPLAY_MOVE_COINCIDE,
+                            cp.l, cp.r, cp.pl, cp.pr, i);
             select_move_coincident(self, cp.pl, cp.pr, i);
+            ++lv->swaps;
             ++cp.pr;
         #endif
             break;
 
         case PLANE_REL_COINCIDE:
+            replay_log_push(log, REPLAY_MOVE_COINCIDE,
+                            cp.l, cp.r, cp.pl, cp.pr, i);
             select_move_coincident(self, cp.pl, cp.pr, i);
+            ++lv->swaps;
             ++cp.pr;
             if (cp.pr+1 < i) --i;
             break;
         }
-        
-        VERBOSE_3
-        (
-            draw_set_clip(pivot);
-            draw_pause();
-        )
     }
     
     /* Output new clipping pivot */
@@ -696,6 +684,45 @@ select_partition(SELF, clip_pivot *pivot)
 
 
 
+/* Bounds a finished node: its coplanar faces and both child subtrees */
+void
+select_bound(SELF, bsp_ind id)
+{
+    bsp_node const *n = g_bsp.d + id;
+    bsp_box *b = g_bsp.box + id;
+    unsigned short i;
+    unsigned char j, k;
+
+    b->min[0] = b->min[1] = b->min[2] =  FLT_MAX;
+    b->max[0] = b->max[1] = b->max[2] = -FLT_MAX;
+
+    for (i = n->pl; i <= n->pr; ++i)
+    {
+        for (k = 0; k < 3; ++k)
+        {
+            float const *v = self->verts[self->faces[i].i[k]].m;
+            for (j = 0; j < 3; ++j)
+            {
+                if (v[j] < b->min[j]) b->min[j] = v[j];
+                if (v[j] > b->max[j]) b->max[j] = v[j];
+            }
+        }
+    }
+
+    for (k = 0; k < 2; ++k)
+    {
+        bsp_ind const c = k ? n->r : n->l;
+        if (c >= g_bsp.occ) continue;
+        for (j = 0; j < 3; ++j)
+        {
+            if (g_bsp.box[c].min[j] < b->min[j]) b->min[j] = g_bsp.box[c].min[j];
+            if (g_bsp.box[c].max[j] > b->max[j]) b->max[j] = g_bsp.box[c].max[j];
+        }
+    }
+}
+
+
+
 /*void
 print_depth(unsigned int depth)
 {
@@ -706,7 +733,8 @@ print_depth(unsigned int depth)
 bsp_ind
 select_iter(SELF,
             clip_pivot *pivot,
-            unsigned int depth)
+            unsigned int depth,
+            select_stats *st)
 {
     /* PARAMS MUST BE VERIFIED FIRST!
      * This function should only be called from select_begin() or recursively,
@@ -718,6 +746,11 @@ select_iter(SELF,
      *   in = number of intersections through the polygon's plane */
     unsigned short best, i, bal, in, score;
     bsp_ind id;
+    select_level *lv;
+    unsigned b;
+    double t;
+    perf_group const *perf = perf_on(st->perf) ? st->perf : NULL;
+    perf_counts c0;
     
     clip_pivot cp = *pivot;
     clip_pivot cparg;
@@ -727,10 +760,17 @@ select_iter(SELF,
     /* Only param check administered */
     if (cp.l >= cp.r) return 0xFFFF;
     
-    /* Recursion depth check */
-    if (depth > rdepth)
-        rdepth = depth;
-    
+    /* Recursion depth and node size */
+    if (depth > st->depth)
+        st->depth = depth;
+    lv = st->level + (depth <= SELECT_STATS_DEPTH ? depth-1
+                                                  : SELECT_STATS_DEPTH-1);
+    ++lv->nodes;
+    lv->faces += cp.r - cp.l;
+    for (b = 0; b+1 < SELECT_STATS_BUCKETS && (cp.r - cp.l) >> (b+1); ++b);
+    ++lv->size_hist[b];
+    trace_begin_args("select_iter", "range", (long)(cp.r - cp.l),
+                                    "depth", (long)depth);
 
 
     VERBOSE_3
@@ -739,23 +779,22 @@ select_iter(SELF,
     )
 
     /* Select initial pivot polygon for BSP */
+    t = timer_now();
+    if (perf) perf_read(perf, &c0);
     best = cp.l;
     select_get_props(self, &in, &bal, cp.l, cp.l, cp.r);
     score = bal + (in<<3);
-    
-    VERBOSE_3
-    (
-        g_draw_mode = DRAW_MODE_REL;
-        draw_set_clip(&cp);
-        draw_pause();
-    )
+    ++lv->candidates;
+    lv->classified += cp.r - cp.l;
 
     for (i = cp.l+1; i < cp.r; ++i)
     {
         /* Candidate balances and intersection counts */
         unsigned short balc, inc, scorec;
 
-        select_get_props(self, &balc, &inc, cp.l, i, cp.r);
+        select_get_props(self, &inc, &balc, cp.l, i, cp.r);
+        ++lv->candidates;
+        lv->classified += cp.r - cp.l;
 
         /* Determine whether this pivot is better than the current best */
         scorec = balc + (inc<<3);
@@ -771,24 +810,44 @@ select_iter(SELF,
                 break;
         }
     }
+    st->t_select += timer_now() - t;
+    if (perf) perf_accum(perf, &c0, &lv->c_select);
     
     VERBOSE_3
     (
         fprintf(stderr, "%hu <- %hu -> %hu)   -> bal=%hu, int=%hu\n",
                         cp.l, best, cp.r, bal, in);
-        
-        draw_set_clip(&cp);
-        draw_pause();
     )
+    replay_log_push(st->log, REPLAY_PIVOT, cp.l, cp.r, best, best, best);
+
 
 
+    /* Each split adds at most two verts and two faces: reserve them all
+     * now so that partitioning never grows the pools */
+    if (!pools_reserve(self, 2U*in, 2U*in))
+    {
+        fprintf(stderr, "  Could not reserve %hu splits.\n", in);
+        ++st->errors;
+        st->full |= self->n_verts + 2U*in > 0xFFFF ||
+                    self->n_faces + 2U*in > 0xFFFF;
+        trace_end();
+        return 0xFFFF;
+    }
 
     /* Partition (allocates BSP node) */
+    t = timer_now();
+    if (perf) perf_read(perf, &c0);
     cp.pl = cp.pr = best;
-    id = select_partition(self, &cp);
+    trace_begin("select_partition");
+    id = select_partition(self, &cp, st, lv);
+    trace_end();
+    st->t_partition += timer_now() - t;
+    if (perf) perf_accum(perf, &c0, &lv->c_partition);
     if (id == 0xFFFF)
     {
-        fprintf(stderr, "  BSP node allocation failure.\n");
+        fprintf(stderr, "  Partition or BSP node allocation failure.\n");
+        ++st->errors;
+        trace_end();
         return 0xFFFF;
     }
     else
@@ -798,19 +857,12 @@ select_iter(SELF,
             fprintf(stderr, "  BSP node allocated, id = %hu\n", id);
         )
     }
-
-    /* Draw the scene with the pivot highlighted and its binary partitioning */
-    VERBOSE_3
-    (
-        draw_set_clip(&cp);
-        draw_pause();
-        draw_set_clip(NULL);
-    )
+    replay_log_push(st->log, REPLAY_NODE, cp.l, cp.r, cp.pl, cp.pr, id);
 
     /* Recurse (and count how much we expand) */
     cparg.l = cp.l;
     cparg.r = cp.pl;
-    bsp_insert_left(&g_bsp, id, select_iter(self, &cparg, depth+1));
+    bsp_insert_left(&g_bsp, id, select_iter(self, &cparg, depth+1, st));
     i = cparg.r - cp.pl;
     cp.pl += i;
     cp.pr += i;
@@ -819,10 +871,14 @@ select_iter(SELF,
     (
         fprintf(stderr, "Left expansion by %hu.\n", i);
     )
+
+    /* Clipping on the left shifts this node's coplanar faces along */
+    g_bsp.d[id].pl = cp.pl;
+    g_bsp.d[id].pr = cp.pr;
     
     cparg.l = cp.pr+1;
     cparg.r = cp.r;
-    bsp_insert_right(&g_bsp, id, select_iter(self, &cparg, depth+1));
+    bsp_insert_right(&g_bsp, id, select_iter(self, &cparg, depth+1, st));
     i = cparg.r - cp.r;
     cp.pl += i;
     cp.pr += i;
@@ -832,16 +888,28 @@ select_iter(SELF,
         fprintf(stderr, "Right expansion by %hu.\n", i);
     )
 
+    /* Children are final: bound the subtree */
+    t = timer_now();
+    select_bound(self, id);
+    st->t_bound += timer_now() - t;
+
     *pivot = cp;
+    trace_end();
     return id;
 }
 
 void output_tree(void);
 
 bool
-select_begin(SELF)
+select_begin(SELF, select_stats *stats)
 {
     clip_pivot cp;
+    size_t est;
+    select_stats local;
+    select_level tot;
+    perf_group const *perf;
+    replay_log *log;
+    double t;
     
     /* Param check */
     if (!self || !self->verts || !self->faces || !self->planes)
@@ -849,27 +917,193 @@ select_begin(SELF)
         return false;
     }
     
-    /* Reset stats */
-    swaps  = 0U;
-    rdepth = 0U;
+    /* Reset stats, and the tree: its root must be node 0 */
+    if (!stats)
+    {
+        stats = &local;
+        local.perf = NULL;
+        local.log  = NULL;
+    }
+    perf = stats->perf;
+    log  = stats->log;
+    memset(stats, 0, sizeof *stats);
+    stats->perf = perf;
+    stats->log  = log;
+    replay_log_clear(log, self);
+    mem_mark();
+    t = timer_now();
+    g_bsp.occ = 0U;
+    bsp_clear(&g_bsp);
+
+    /* Size the pools for the whole build. Nodes reserve exactly what they
+     * split, so a low estimate only costs a growth later. */
+    est = self->n_faces / SELECT_SPLIT_EST * 2U;
+    if (!pools_reserve(self, est < 0xFFFF - self->n_verts ?
+                             est : 0xFFFF - self->n_verts, est))
+    {
+        VERBOSE_2(fprintf(stderr, "WARNING: select_begin(estimate) failed.\n");)
+    }
     
     /* Begin iteration */
     cp.l = 0U;
     cp.r = self->n_faces;
     cp.pl = cp.pr = 0U;
-    select_iter(self, &cp, 1);
+    select_iter(self, &cp, 1, stats);
     g_bsp_l = 0;
     g_bsp_r = -1;
+    stats->t_total  = timer_now() - t;
+    stats->mem_peak = g_mem.mark_peak;
     
     /* Print stats */
-    printf("Total BSP swaps: %u.\nTotal recursion levels: %u.\n"
-           "Total new polys: %u.\n", swaps, rdepth, clips);
+    select_stats_total(stats, &tot);
+    printf("Total BSP swaps: %zu.\nTotal recursion levels: %u.\n"
+           "Total new polys: %zu.\nPeak memory: %zu KiB.\n", tot.swaps,
+           stats->depth, tot.new_faces, stats->mem_peak >> 10);
     
     output_tree();
-    
-    return true;
+
+    if (stats->errors)
+        fprintf(stderr, "%zu nodes could not be built.\n", stats->errors);
+    return !stats->errors;
+}
+
+
+
+static void
+select_level_add(select_level *dst, select_level const *src)
+{
+    unsigned b;
+
+    dst->nodes      += src->nodes;
+    dst->faces      += src->faces;
+    for (b = 0; b < SELECT_STATS_BUCKETS; ++b)
+        dst->size_hist[b] += src->size_hist[b];
+    dst->splits     += src->splits;
+    dst->new_faces  += src->new_faces;
+    dst->swaps      += src->swaps;
+    dst->candidates += src->candidates;
+    dst->classified += src->classified;
+    perf_add(&dst->c_select,    &src->c_select);
+    perf_add(&dst->c_partition, &src->c_partition);
+    perf_add(&dst->c_clip,      &src->c_clip);
+}
+
+void
+select_stats_merge(select_stats *dst, select_stats const *src)
+{
+    unsigned d;
+
+    if (!dst || !src) return;
+
+    if (src->depth > dst->depth) dst->depth = src->depth;
+    if (src->mem_peak > dst->mem_peak) dst->mem_peak = src->mem_peak;
+    dst->t_select    += src->t_select;
+    dst->t_partition += src->t_partition;
+    dst->t_bound     += src->t_bound;
+    dst->t_total     += src->t_total;
+    dst->errors      += src->errors;
+    dst->full        |= src->full;
+    for (d = 0; d < SELECT_STATS_DEPTH; ++d)
+        select_level_add(dst->level + d, src->level + d);
+}
+
+void
+select_stats_total(select_stats const *stats, select_level *out)
+{
+    unsigned d;
+
+    if (!out) return;
+    memset(out, 0, sizeof *out);
+    if (!stats) return;
+
+    for (d = 0; d < SELECT_STATS_DEPTH; ++d)
+        select_level_add(out, stats->level + d);
+}
+
+static void
+select_level_json(select_level const *lv, unsigned mask, FILE *f)
+{
+    unsigned b;
+
+    fprintf(f, "\"nodes\": %zu, \"faces\": %zu, \"splits\": %zu, "
+               "\"new_faces\": %zu, \"swaps\": %zu, \"candidates\": %zu, "
+               "\"classified\": %zu, \"size_hist\": [",
+               lv->nodes, lv->faces, lv->splits, lv->new_faces, lv->swaps,
+               lv->candidates, lv->classified);
+    for (b = 0; b < SELECT_STATS_BUCKETS; ++b)
+        fprintf(f, b ? ", %zu" : "%zu", lv->size_hist[b]);
+    fputc(']', f);
+
+    if (!mask) return;
+    fprintf(f, ", \"counters\": {\"select\": ");
+    perf_json(f, &lv->c_select, mask);
+    fprintf(f, ", \"partition\": ");
+    perf_json(f, &lv->c_partition, mask);
+    fprintf(f, ", \"clip\": ");
+    perf_json(f, &lv->c_clip, mask);
+    fputc('}', f);
 }
 
+bool
+select_stats_json(select_stats const *stats, FILE *f)
+{
+    select_level tot;
+    unsigned d, n, mask;
+
+    if (!stats || !f) return false;
+    mask = perf_on(stats->perf) ? stats->perf->mask : 0U;
+
+    select_stats_total(stats, &tot);
+    n = stats->depth < SELECT_STATS_DEPTH ? stats->depth : SELECT_STATS_DEPTH;
+
+    fprintf(f, "{\n  \"depth\": %u,\n"
+               "  \"time_ms\": {\"select\": %.3f, \"partition\": %.3f, "
+               "\"bound\": %.3f, \"total\": %.3f},\n"
+               "  \"mem_peak_bytes\": %zu,\n  \"errors\": %zu, "
+               "\"full\": %s,\n  \"total\": {",
+               stats->depth, stats->t_select * 1e3, stats->t_partition * 1e3,
+               stats->t_bound * 1e3, stats->t_total * 1e3, stats->mem_peak,
+               stats->errors, stats->full ? "true" : "false");
+    select_level_json(&tot, mask, f);
+    fprintf(f, "},\n  \"levels\": [");
+    for (d = 0; d < n; ++d)
+    {
+        fprintf(f, d ? ",\n    {" : "\n    {");
+        select_level_json(stats->level + d, mask, f);
+        fputc('}', f);
+    }
+    fprintf(f, "%s]\n}\n", n ? "\n  " : "");
+
+    return !ferror(f);
+}
+
+void
+select_stats_perf(select_stats const *stats, FILE *f)
+{
+    select_level tot;
+    unsigned d, n, mask;
+    char label[32];
+
+    if (!stats || !f || !perf_on(stats->perf)) return;
+    mask = stats->perf->mask;
+
+    select_stats_total(stats, &tot);
+    perf_print(f, "select",    &tot.c_select,    mask);
+    perf_print(f, "partition", &tot.c_partition, mask);
+    perf_print(f, "clip",      &tot.c_clip,      mask);
+
+    n = stats->depth < SELECT_STATS_DEPTH ? stats->depth : SELECT_STATS_DEPTH;
+    for (d = 0; d < n; ++d)
+    {
+        perf_counts c = stats->level[d].c_select;
+
+        perf_add(&c, &stats->level[d].c_partition);
+        sprintf(label, "depth %u", d+1);
+        perf_print(f, label, &c, mask);
+    }
+}
+
+
 
 void output_tree_node_indent(FILE *f, unsigned short level)
 {
@@ -13,8 +13,61 @@
 #ifndef SELECT_H
 #define SELECT_H
 
+#include "perf.h"
 #include "pools.h"
+#include "replay.h"
 
-bool select_begin(SELF_PARAM(pools) pool);
+#include <stdio.h>
+
+#define SELECT_STATS_DEPTH   64 /* Deeper levels share the last entry */
+#define SELECT_STATS_BUCKETS 17 /* Node sizes by power of two, to 2^16 */
+
+typedef struct {
+    size_t nodes, faces;  /* Nodes at this depth and the faces they held */
+    size_t size_hist[SELECT_STATS_BUCKETS]; /* [b]: sizes 2^b to 2^(b+1)-1 */
+    size_t splits, new_faces, swaps;
+    size_t candidates;    /* Pivots scored */
+    size_t classified;    /* Face against plane tests */
+    perf_counts c_select, c_partition, c_clip; /* Partition includes clip */
+} select_level;
+
+typedef struct {
+    unsigned     depth;   /* Deepest level reached */
+    double       t_select, t_partition, t_bound, t_total; /* Seconds */
+    size_t       mem_peak; /* Most bytes held by pools and tree (mem.h) */
+    size_t       errors;   /* Nodes abandoned: unreserved split, no node */
+    bool         full;     /* Some for want of 16 bit vertex or face ids */
+    select_level level[SELECT_STATS_DEPTH];
+    perf_group const *perf; /* Counters to read, opened by the caller */
+    replay_log       *log;  /* Events to record, when given */
+} select_stats;
+
+/* Builds the tree over the pool, false if any node had to be abandoned.
+ * When given, stats is cleared and filled:
+ * each build owns its own, so parallel builds only need to merge them.
+ * Only perf and log are kept: counters are read when perf is on, and the
+ * log is cleared and recorded into when given. */
+bool select_begin(SELF_PARAM(pools) pool, select_stats *stats);
+
+/* Counts the faces of [l, r) that the plane of fi splits, and how far it
+ * is from halving the rest, marking each plane's rel for DRAW_MODE_REL */
+void select_get_props(SELF_PARAM(pools) pool,
+                      unsigned short *ints_out, unsigned short *bal_out,
+                      unsigned short l, unsigned short fi, unsigned short r);
+
+/* Moves face elem beside the pivot [pivot_l, pivot_r], or into it */
+void select_move_left      (SELF_PARAM(pools) pool, unsigned short pivot_l,
+                            unsigned short pivot_r, unsigned short elem);
+void select_move_right     (SELF_PARAM(pools) pool, unsigned short pivot_l,
+                            unsigned short pivot_r, unsigned short elem);
+void select_move_coincident(SELF_PARAM(pools) pool, unsigned short pivot_l,
+                            unsigned short pivot_r, unsigned short elem);
+
+void select_stats_merge(select_stats *dst, select_stats const *src);
+void select_stats_total(select_stats const *stats, select_level *out);
+bool select_stats_json (select_stats const *stats, FILE *f);
+
+/* Prints the counters read per phase and per depth */
+void select_stats_perf(select_stats const *stats, FILE *f);
 
 #endif /* SELECT_H */
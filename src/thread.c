@@ -0,0 +1,321 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Minimal fork/join worker threads for splitting independent work items
+    (queries, loading) across the available processors.
+*******************************************************************************/
+
+#include "thread.h"
+#include "trace.h"
+#include "verbose.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef OS_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#elif defined(OS_LINUX)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define THREAD_MAX 64
+
+
+
+typedef struct {
+    thread_job job;
+    void      *arg;
+    size_t     begin, end;
+} thread_slice;
+
+struct thread_ {
+#ifdef OS_WINDOWS
+    HANDLE    h;
+#elif defined(OS_LINUX)
+    pthread_t h;
+#endif
+    void    (*fn)(void *arg);
+    void     *arg;
+};
+
+struct thread_gate_ {
+#ifdef OS_WINDOWS
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE cond;
+#elif defined(OS_LINUX)
+    pthread_mutex_t    lock;
+    pthread_cond_t     cond;
+#endif
+    size_t value;
+    bool   closed;
+};
+
+
+
+unsigned
+thread_count(void)
+{
+#ifdef OS_WINDOWS
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors ? (unsigned)si.dwNumberOfProcessors : 1U;
+#elif defined(OS_LINUX)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1U;
+#else
+    return 1U;
+#endif
+}
+
+
+
+static void
+thread_run(thread_slice const *s)
+{
+    trace_begin_args("thread_slice", "begin", (long)s->begin,
+                                     "items", (long)(s->end - s->begin));
+    s->job(s->arg, s->begin, s->end);
+    trace_end();
+}
+
+#ifdef OS_WINDOWS
+static DWORD WINAPI
+thread_main(LPVOID p)
+{
+    thread_run(p);
+    trace_release();
+    return 0;
+}
+#elif defined(OS_LINUX)
+static void *
+thread_main(void *p)
+{
+    thread_run(p);
+    trace_release();
+    return NULL;
+}
+#endif
+
+
+
+bool
+thread_for(thread_job job, void *arg, size_t n, unsigned threads)
+{
+    thread_slice slices[THREAD_MAX];
+#ifdef OS_WINDOWS
+    HANDLE    handles[THREAD_MAX];
+#elif defined(OS_LINUX)
+    pthread_t handles[THREAD_MAX];
+#endif
+    bool   started[THREAD_MAX] = {0};
+    size_t step, i;
+
+    if (!job) return false;
+    if (!n)   return true;
+
+    if (!threads) threads = thread_count();
+    if (threads > THREAD_MAX) threads = THREAD_MAX;
+    if (threads > n) threads = (unsigned)n;
+
+    /* Contiguous slices, the remainder spread over the first few */
+    step = n / threads;
+    for (i = 0; i < threads; ++i)
+    {
+        slices[i].job   = job;
+        slices[i].arg   = arg;
+        slices[i].begin = i ? slices[i-1].end : 0U;
+        slices[i].end   = slices[i].begin + step + (i < n % threads);
+    }
+
+    for (i = 1; i < threads; ++i)
+    {
+#ifdef OS_WINDOWS
+        handles[i] = CreateThread(NULL, 0, thread_main, slices+i, 0, NULL);
+        started[i] = handles[i] != NULL;
+#elif defined(OS_LINUX)
+        started[i] = !pthread_create(handles+i, NULL, thread_main, slices+i);
+#endif
+        if (!started[i])
+        {
+            VERBOSE_2
+            (
+                fprintf(stderr, "WARNING: thread_for() could not start thread "
+                                "%zu, running its slice inline.\n", i);
+            )
+        }
+    }
+
+    /* The caller takes the first slice (and any that failed to start) */
+    thread_run(slices);
+
+    for (i = 1; i < threads; ++i)
+    {
+        if (!started[i])
+        {
+            thread_run(slices + i);
+            continue;
+        }
+#ifdef OS_WINDOWS
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#elif defined(OS_LINUX)
+        pthread_join(handles[i], NULL);
+#endif
+    }
+
+    return true;
+}
+
+
+
+#ifdef OS_WINDOWS
+static DWORD WINAPI
+thread_single(LPVOID p)
+{
+    thread *t = p;
+    t->fn(t->arg);
+    trace_release();
+    return 0;
+}
+#elif defined(OS_LINUX)
+static void *
+thread_single(void *p)
+{
+    thread *t = p;
+    t->fn(t->arg);
+    trace_release();
+    return NULL;
+}
+#endif
+
+thread *
+thread_start(void (*fn)(void *arg), void *arg)
+{
+    thread *t;
+
+    if (!fn) return NULL;
+
+    t = malloc(sizeof(thread));
+    if (!t) return NULL;
+    t->fn  = fn;
+    t->arg = arg;
+
+#ifdef OS_WINDOWS
+    t->h = CreateThread(NULL, 0, thread_single, t, 0, NULL);
+    if (t->h) return t;
+#elif defined(OS_LINUX)
+    if (!pthread_create(&t->h, NULL, thread_single, t)) return t;
+#endif
+
+    free(t);
+    return NULL;
+}
+
+void
+thread_join(thread *t)
+{
+    if (!t) return;
+#ifdef OS_WINDOWS
+    WaitForSingleObject(t->h, INFINITE);
+    CloseHandle(t->h);
+#elif defined(OS_LINUX)
+    pthread_join(t->h, NULL);
+#endif
+    free(t);
+}
+
+
+
+thread_gate *
+thread_gate_new(void)
+{
+    thread_gate *g = malloc(sizeof(thread_gate));
+
+    if (!g) return NULL;
+    g->value  = 0U;
+    g->closed = false;
+#ifdef OS_WINDOWS
+    InitializeCriticalSection(&g->lock);
+    InitializeConditionVariable(&g->cond);
+#elif defined(OS_LINUX)
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->cond, NULL);
+#endif
+    return g;
+}
+
+void
+thread_gate_free(thread_gate *g)
+{
+    if (!g) return;
+#ifdef OS_WINDOWS
+    DeleteCriticalSection(&g->lock);
+#elif defined(OS_LINUX)
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->cond);
+#endif
+    free(g);
+}
+
+static void
+thread_gate_set(thread_gate *g, size_t value, bool closed)
+{
+#ifdef OS_WINDOWS
+    EnterCriticalSection(&g->lock);
+    g->value   = value;
+    g->closed |= closed;
+    LeaveCriticalSection(&g->lock);
+    WakeAllConditionVariable(&g->cond);
+#elif defined(OS_LINUX)
+    pthread_mutex_lock(&g->lock);
+    g->value   = value;
+    g->closed |= closed;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+#else
+    g->value   = value;
+    g->closed |= closed;
+#endif
+}
+
+void
+thread_gate_post(thread_gate *g, size_t value)
+{
+    if (g) thread_gate_set(g, value, false);
+}
+
+void
+thread_gate_close(thread_gate *g)
+{
+    if (g) thread_gate_set(g, g->value, true);
+}
+
+size_t
+thread_gate_wait(thread_gate *g, size_t value)
+{
+    size_t v;
+
+    if (!g) return 0U;
+#ifdef OS_WINDOWS
+    EnterCriticalSection(&g->lock);
+    while (g->value < value && !g->closed)
+        SleepConditionVariableCS(&g->cond, &g->lock, INFINITE);
+    v = g->value;
+    LeaveCriticalSection(&g->lock);
+#elif defined(OS_LINUX)
+    pthread_mutex_lock(&g->lock);
+    while (g->value < value && !g->closed)
+        pthread_cond_wait(&g->cond, &g->lock);
+    v = g->value;
+    pthread_mutex_unlock(&g->lock);
+#else
+    v = g->value;
+#endif
+    return v;
+}
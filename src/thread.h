@@ -0,0 +1,43 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Minimal fork/join worker threads for splitting independent work items
+    (queries, loading) across the available processors.
+*******************************************************************************/
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Processes items [begin, end) of a job */
+typedef void (*thread_job)(void *arg, size_t begin, size_t end);
+
+unsigned thread_count(void); /* Number of online processors (at least 1) */
+
+/* Splits [0, n) into contiguous slices over at most `threads` threads
+ * (0 = thread_count()) and returns once every slice is processed.
+ * The calling thread processes the first slice itself. */
+bool thread_for(thread_job job, void *arg, size_t n, unsigned threads);
+
+/* A single started worker, and a progress counter one thread posts to while
+ * others wait for it to reach a value */
+typedef struct thread_      thread;
+typedef struct thread_gate_ thread_gate;
+
+thread *thread_start(void (*fn)(void *arg), void *arg); /* NULL on failure */
+void    thread_join (thread *t);
+
+thread_gate *thread_gate_new  (void);
+void         thread_gate_free (thread_gate *g);
+void         thread_gate_post (thread_gate *g, size_t value);
+void         thread_gate_close(thread_gate *g); /* No more posts: wake all */
+
+/* Blocks until the posted value reaches `value` or the gate closes, and
+ * returns the posted value */
+size_t thread_gate_wait(thread_gate *g, size_t value);
+
+#endif /* THREAD_H */
@@ -0,0 +1,40 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Monotonic wall clock for timing load passes and measurements.
+*******************************************************************************/
+
+#include "timer.h"
+
+#ifdef OS_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#elif defined(OS_LINUX)
+#include <time.h>
+#endif
+
+
+
+double
+timer_now(void)
+{
+#ifdef OS_WINDOWS
+    static LARGE_INTEGER f;
+    LARGE_INTEGER t;
+
+    if (!f.QuadPart) QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)f.QuadPart;
+#elif defined(OS_LINUX)
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#else
+    return 0.0;
+#endif
+}
@@ -0,0 +1,14 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Monotonic wall clock for timing load passes and measurements.
+*******************************************************************************/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+double timer_now(void); /* Seconds since an arbitrary fixed point */
+
+#endif /* TIMER_H */
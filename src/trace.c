@@ -0,0 +1,219 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Scoped begin / end markers recorded into a ring buffer per thread, and
+    written out as Chrome trace_event JSON. Markers cost one branch while
+    tracing is off.
+*******************************************************************************/
+
+#include "trace.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef OS_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define TRACE_TLS       __thread
+#define trace_take_(f)  __sync_bool_compare_and_swap((f), 0U, 1U)
+#define trace_give_(f)  __sync_lock_release(f)
+#define trace_count_(n) __sync_fetch_and_add((n), 1U)
+#elif defined(OS_WINDOWS)
+#define TRACE_TLS       __declspec(thread)
+#define trace_take_(f)  \
+    (InterlockedCompareExchange((LONG volatile *)(f), 1, 0) == 0)
+#define trace_give_(f)  InterlockedExchange((LONG volatile *)(f), 0)
+#define trace_count_(n) InterlockedIncrement((LONG volatile *)(n))
+#else
+#error "Thread local storage required"
+#endif
+
+
+
+typedef struct {
+    double      ts;     /* Seconds since trace_start */
+    char const *name;
+    char const *k[2];   /* Argument names, NULL when unused */
+    long        v[2];
+    char        ph;     /* 'B' or 'E' */
+} trace_event;
+
+typedef struct {
+    trace_event *e;
+    size_t       n;     /* Events pushed, the last cap of them kept */
+} trace_ring;
+
+bool trace_on_ = false;
+
+static trace_ring        trace_rings[TRACE_THREADS];
+static unsigned volatile trace_busy_[TRACE_THREADS]; /* Held by a thread */
+static unsigned volatile trace_lost_; /* Threads that found none free */
+static unsigned          trace_gen_;  /* Bumped by every start */
+static size_t            trace_cap_;
+static double            trace_t0_;
+
+/* This thread's ring, valid while its generation is current */
+static TRACE_TLS trace_ring *trace_mine_;
+static TRACE_TLS unsigned    trace_mine_gen_;
+
+
+
+/* Rings are allocated as threads first record */
+bool
+trace_start(size_t events)
+{
+    trace_stop();
+
+    trace_cap_  = events ? events : TRACE_EVENTS;
+    trace_lost_ = 0U;
+    ++trace_gen_;
+    trace_t0_  = timer_now();
+    trace_on_  = true;
+    return true;
+}
+
+void
+trace_stop(void)
+{
+    unsigned i;
+
+    trace_on_ = false;
+    for (i = 0; i < TRACE_THREADS; ++i)
+    {
+        free(trace_rings[i].e);
+        trace_rings[i].e = NULL;
+        trace_rings[i].n = 0U;
+        trace_busy_[i]   = 0U;
+    }
+}
+
+/* A ring outlives the thread holding it: the next thread to record takes
+ * it over, so short-lived workers reuse a few lanes instead of each
+ * claiming its own */
+void
+trace_release(void)
+{
+    if (trace_mine_ && trace_mine_gen_ == trace_gen_)
+        trace_give_(trace_busy_ + (trace_mine_ - trace_rings));
+    trace_mine_     = NULL;
+    trace_mine_gen_ = 0U;
+}
+
+
+
+void
+trace_push_(char ph, char const *name,
+            char const *k0, long v0, char const *k1, long v1)
+{
+    trace_ring *r = trace_mine_;
+    trace_event *e;
+
+    if (trace_mine_gen_ != trace_gen_)
+    {
+        unsigned id;
+
+        for (id = 0; id < TRACE_THREADS && !trace_take_(trace_busy_ + id);
+             ++id);
+
+        r = id < TRACE_THREADS ? trace_rings + id : NULL;
+        if (!r) trace_count_(&trace_lost_);
+        if (r && !r->e &&
+            !(r->e = malloc(trace_cap_ * sizeof(trace_event))))
+        {
+            fprintf(stderr, "Failed to allocate a trace ring.\n");
+            r = NULL;
+        }
+        trace_mine_     = r;
+        trace_mine_gen_ = trace_gen_;
+    }
+    if (!r) return;
+
+    e = r->e + r->n++ % trace_cap_;
+    e->ts   = timer_now() - trace_t0_;
+    e->name = name;
+    e->k[0] = k0;
+    e->k[1] = k1;
+    e->v[0] = v0;
+    e->v[1] = v1;
+    e->ph   = ph;
+}
+
+
+
+static void
+trace_write_event(FILE *f, trace_event const *e, unsigned tid, bool first)
+{
+    unsigned k;
+
+    fprintf(f, "%s\n{\"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u",
+               first ? "" : ",", e->ph, e->ts * 1e6, tid);
+    if (e->name) fprintf(f, ", \"name\": \"%s\"", e->name);
+    if (e->k[0])
+    {
+        fprintf(f, ", \"args\": {");
+        for (k = 0; k < 2 && e->k[k]; ++k)
+        {
+            fprintf(f, "%s\"%s\": %ld", k ? ", " : "", e->k[k], e->v[k]);
+        }
+        fputc('}', f);
+    }
+    fputc('}', f);
+}
+
+bool
+trace_dump(char const *path)
+{
+    FILE *f;
+    unsigned i, n;
+    size_t j, dropped = 0U;
+    bool first = true, ok;
+
+    if (!path || !trace_cap_) return false;
+
+    f = fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open trace file \"%s\".\n", path);
+        return false;
+    }
+
+    n = TRACE_THREADS;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (i = 0; i < n; ++i)
+    {
+        trace_ring const *r = trace_rings + i;
+        size_t const from = r->n > trace_cap_ ? r->n - trace_cap_ : 0U;
+
+        if (!r->e) continue;
+        dropped += from;
+        for (j = from; j < r->n; ++j)
+        {
+            trace_write_event(f, r->e + j % trace_cap_, i + 1U, first);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    ok = !ferror(f);
+    ok = !fclose(f) && ok;
+
+    if (dropped)
+    {
+        fprintf(stderr, "Trace rings overran: %zu oldest events dropped.\n",
+                        dropped);
+    }
+    if (trace_lost_)
+    {
+        fprintf(stderr, "Trace: %u threads were not recorded.\n",
+                        trace_lost_);
+    }
+    return ok;
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************
+    Binary Spatial Partitioning Algorithm
+        Author: Callum David Ames               All Rights Reserved
+        Date Initiated: July 2024
+
+    Scoped begin / end markers recorded into a ring buffer per thread, and
+    written out as Chrome trace_event JSON. Markers cost one branch while
+    tracing is off.
+*******************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TRACE_EVENTS  (1U<<16) /* Default ring size per thread */
+#define TRACE_THREADS 64       /* Threads recording at once; others lost */
+
+extern bool trace_on_;
+
+void trace_push_(char ph, char const *name,
+                 char const *k0, long v0, char const *k1, long v1);
+
+
+
+/* Starts recording with rings of `events` (0 for TRACE_EVENTS). Earlier
+ * events are dropped. */
+bool trace_start(size_t events);
+
+/* Writes what the rings hold, oldest first. No thread may be recording. */
+bool trace_dump(char const *path);
+
+void trace_stop(void); /* Stops recording and frees the rings */
+
+/* Hands this thread's ring on to the next thread that records: call it as
+ * a worker exits. Events keep the ring's lane in the trace. */
+void trace_release(void);
+
+/* Names and keys must be string literals: only the pointers are kept */
+static inline void
+trace_begin(char const *name)
+{
+    if (trace_on_) trace_push_('B', name, NULL, 0L, NULL, 0L);
+}
+
+static inline void
+trace_begin_args(char const *name, char const *k0, long v0,
+                                   char const *k1, long v1)
+{
+    if (trace_on_) trace_push_('B', name, k0, v0, k1, v1);
+}
+
+static inline void
+trace_end(void)
+{
+    if (trace_on_) trace_push_('E', NULL, NULL, 0L, NULL, 0L);
+}
+
+#endif /* TRACE_H */
@@ -8,11 +8,15 @@
 
 #include "camera.h"
 #include "draw.h"
+#include "mem.h"
+#include "quality.h"
 #include "select.h"
+#include "trace.h"
 #include "bsp.h"
 #include "window.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #ifdef OS_WINDOWS
 #ifndef WIN32_LEAN_AND_MEAN
@@ -20,8 +24,11 @@
 #include <windows.h>
 #endif
 #elif defined(OS_LINUX)
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
-#include <sched.h>
+#include <sys/timerfd.h>
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -35,6 +42,8 @@
 #define CLASS_NAME "ENOBY_BSP"
 #define APP_NAME   "Enoby BSP Viewer"
 
+#define WINDOW_DELTA_MAX 0.25f /* Longest step the camera takes at once */
+
 
 
 #ifdef OS_WINDOWS
@@ -50,8 +59,13 @@ bool XMsgProc(XEvent *msg);
 
 
 
-extern pools g_pool;
-extern bsp   g_bsp;
+extern pools      g_pool;
+extern bsp        g_bsp;
+extern perf_group g_perf;
+extern replay_log  g_record;
+extern replay_view g_replay;
+extern char const *g_record_out;
+extern bool g_shrink;
 extern unsigned short
     g_bsp_l, g_bsp_r, g_pivot_l, g_pivot_r, g_pivot,
     g_poly_clip, g_poly_inter, g_vert_012[3];
@@ -65,6 +79,7 @@ LARGE_INTEGER t0, t1;
 HWND          g_wnd;
 #elif defined(OS_LINUX)
 struct timespec t0, t1;
+int             g_timer = -1; /* Wakes the loop for the next frame */
 
 Display *g_display;
 Atom     g_wm_delete_window;
@@ -80,6 +95,10 @@ bool g_lapse = false,
      g_stall = false,
      g_scheduleSelect = false;
 
+static float g_period = 1.0f / 60.0f;
+static bool  g_lazy   = false,
+             g_dirty  = true;
+
 
 
 #ifdef OS_WINDOWS
@@ -170,9 +189,12 @@ window_init(unsigned int w,
     QueryPerformanceCounter(&t0);
     t1 = t0;
 #elif defined(OS_LINUX)
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t0);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
     t1 = t0;
 
+    /* Without a timer, waits fall back to poll's millisecond timeout */
+    g_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
     g_display = XOpenDisplay(NULL);
     if (!g_display)
     {
@@ -272,6 +294,11 @@ window_cleanup(void)
         g_wnd = NULL;
     }
 #elif defined OS_LINUX
+    if (g_timer >= 0)
+    {
+        close(g_timer);
+        g_timer = -1;
+    }
     if (g_display)
     {
         if (g_glrc)
@@ -306,6 +333,76 @@ window_get_aspect_ratio(void)
 
 
 
+void
+window_set_rate(unsigned int fps, bool lazy)
+{
+    g_period = 1.0f / (float)(fps ? fps : 60U);
+    g_lazy   = lazy;
+}
+
+void
+window_dirty(void)
+{
+    g_dirty = true;
+}
+
+
+
+#ifdef OS_LINUX
+static long long
+window_ns(struct timespec const *t)
+{
+    return (long long)t->tv_sec * 1000000000LL + (long long)t->tv_nsec;
+}
+
+/* Sleeps until X has an event for us or, if a frame is wanted, until
+ * `due` on the monotonic clock */
+static void
+window_wait(bool frame, long long due)
+{
+    struct pollfd     fd[2];
+    struct itimerspec when;
+    uint64_t          fired;
+    nfds_t            n = 1;
+    int               ms = -1;
+
+    /* Events already read into Xlib's queue would not wake the poll */
+    if (XPending(g_display)) return;
+
+    fd[0].fd     = ConnectionNumber(g_display);
+    fd[0].events = POLLIN;
+
+    memset(&when, 0, sizeof(when));
+    if (frame)
+    {
+        when.it_value.tv_sec  = (time_t)(due / 1000000000LL);
+        when.it_value.tv_nsec = (long)(due % 1000000000LL);
+    }
+    if (g_timer >= 0 &&
+        !timerfd_settime(g_timer, TFD_TIMER_ABSTIME, &when, NULL))
+    {
+        fd[1].fd     = g_timer;
+        fd[1].events = POLLIN;
+        n = 2;
+    }
+    else if (frame)
+    {
+        long long const left = due - window_ns(&t1);
+
+        ms = left > 0 ? (int)((left + 999999LL) / 1000000LL) : 0;
+    }
+
+    fd[0].revents = fd[1].revents = 0;
+    if (poll(fd, n, ms) > 0 && n == 2 && (fd[1].revents & POLLIN))
+    {
+        /* Rearmed or disarmed next time round: just clear it */
+        if (read(g_timer, &fired, sizeof(fired)) < 0) fired = 0U;
+    }
+}
+#endif
+
+
+
 bool
 window_loop(void)
 {
@@ -316,6 +413,7 @@ window_loop(void)
     unsigned int numEvents;
 #endif
     float delta;
+    bool  frame;
 
 #ifdef OS_WINDOWS
     /* Get messages */
@@ -325,6 +423,7 @@ window_loop(void)
         
         TranslateMessage(&msg);
         DispatchMessage (&msg);
+        g_dirty = true;
     }
 
     /* Get time elapsed */
@@ -339,56 +438,66 @@ window_loop(void)
     {
         XNextEvent(g_display, &msg);
         if (!XMsgProc(&msg)) return false;
+        g_dirty = true;
     }
 
-    /* Get time elapsed */
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    delta = (float)
-    (
-        (long double) (
-            ((long long)t1.tv_sec * (long long)1000000000ULL +
-                                    (long long)t1.tv_nsec)
-           -((long long)t0.tv_sec * (long long)1000000000ULL +
-                                    (long long)t0.tv_nsec)
-        ) / (long double)1000000000.0L
-    );
+    /* Get wall time elapsed */
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    delta = (float)((double)(window_ns(&t1) - window_ns(&t0)) / 1e9);
 #endif
-    
-    if (delta >= 0.016666667f)
+
+    frame = !g_lazy || g_dirty || g_scheduleSelect || camera_moving();
+    if (frame && delta >= g_period)
     {
         t0 = t1;
+        g_dirty = false;
+        trace_begin("frame");
 
-        /* Update camera */
-        camera_update(delta);
+        /* Update camera, without leaping after an idle spell or a build */
+        camera_update(delta < WINDOW_DELTA_MAX ? delta : WINDOW_DELTA_MAX);
 
         if (g_scheduleSelect)
         {
+            select_stats st;
+            quality q;
+
             g_scheduleSelect = false;
-            select_begin(&g_pool);
+            st.perf = &g_perf;
+            st.log  = g_record_out ? &g_record : NULL;
+            select_begin(&g_pool, &st);
+            select_stats_perf(&st, stdout);
+            if (quality_measure(&g_bsp, &g_pool, st.level[0].faces, 0U, &q))
+                quality_print(&q, stdout);
+            if (g_shrink && !(pools_shrink(&g_pool) && bsp_shrink(&g_bsp)))
+                fprintf(stderr, "Could not cut memory to fit.\n");
+            mem_report(stdout, &g_pool, &g_bsp);
+
+            /* Later builds start from a partitioned pool: keep the first */
+            if (g_record_out)
+            {
+                replay_write(&g_record, g_record_out);
+                replay_log_free(&g_record);
+                g_record_out = NULL;
+            }
+
+            /* Show the finished tree even if nothing else moves */
+            window_dirty();
         }
         
         draw(DRAW_MODE_UNSPECIFIED);
+        trace_end();
     }
     else
     {
-        if (delta < 0.01f)
-        {
 #ifdef OS_WINDOWS
-            Sleep(5);
-#elif defined(OS_LINUX)
-            sched_yield();
-            //nanosleep(1);
-#endif
-        }
+        if (!frame)
+            WaitMessage();
         else
-        {
-#ifdef OS_WINDOWS
-            Sleep(0);
+            Sleep(g_period - delta >= 0.002f ? 1 : 0);
 #elif defined(OS_LINUX)
-            sched_yield();
-            //nanosleep(1);
+        window_wait(frame, window_ns(&t0) +
+                           (long long)((double)g_period * 1e9));
 #endif
-        }
     }
 
     return true;
@@ -664,11 +773,20 @@ MsgKeyDown(int keycode)
         break;
 
     case KEYCODE_RETURN:
-        g_stall = false;
+        if (g_stall)
+            g_stall = false;
+        else if (g_replay.log.n)
+        {
+            if (replay_step(&g_replay, &g_pool))
+                window_dirty();
+            else
+                fprintf(stderr, "End of build log.\n");
+        }
         break;
 
     case KEYCODE_SPACE:
-        if (!g_stall)
+        /* A build would move the faces out from under the log */
+        if (!g_stall && !g_replay.log.n)
             g_scheduleSelect = true;            
         break;
 
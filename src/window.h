@@ -15,6 +15,12 @@ bool window_init_default(void);
 bool window_init(unsigned int w, unsigned int h);
 bool window_loop(void);
 
+/* Frames per second to aim for, 60 by default. Lazily, frames are drawn
+ * only after input, while the camera moves, or on window_dirty, and the
+ * loop sleeps in between. */
+void window_set_rate(unsigned int fps, bool lazy);
+void window_dirty(void);
+
 float window_get_aspect_ratio(void);
 
 #endif /* WINDOW_H */